@@ -4,6 +4,7 @@
 
 typedef unsigned int uint;
 typedef unsigned char uchar;
+typedef unsigned short ushort;
 
 constexpr int UCHAR_MAX_AS_INT = 255;
 constexpr double UCHAR_MAX = 255.0;
@@ -14,6 +15,8 @@ struct Cell
     uchar R;
     uchar G;
     uchar B;
+    // R + G + B, written together with the genome so that it is never recomputed.
+    ushort fitness;
 
     bool isEmpty;
     Point cellLocation;
@@ -22,6 +25,7 @@ struct Cell
     Cell()
     {
         isEmpty = true;
+        fitness = 0;
     }
 
     Cell(Point location)
@@ -31,6 +35,7 @@ struct Cell
         R = 0;
         G = 0;
         B = 0;
+        fitness = 0;
     }
 
     Cell(Point location, const uchar r, const uchar g, const uchar b)
@@ -40,11 +45,12 @@ struct Cell
         R = r;
         G = g;
         B = b;
+        fitness = (ushort)(r + g + b);
     }
 
     double get_fitness() const
     {
-        return ((double)R + (double)G + (double)B);
+        return (double)fitness;
     }
 
     double get_objective() const
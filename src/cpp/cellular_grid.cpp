@@ -8,415 +8,1132 @@ Cell &CellularGrid::at(uint row, uint col)
     return currentPopulation[(row * colCount) + col];
 }
 
+Cell CellularGrid::get_cell(uint row, uint col) const
+{
+    if (uses_planes())
+        return currentPlanes.get_cell(currentPlanes.index(row, col));
+    if (uses_packed_cells())
+    {
+        const PackedCell &cell = currentPackedCells[(row * colCount) + col];
+        return Cell(Point(col, row), cell.red(), cell.green(), cell.blue());
+    }
+    return currentPopulation[(row * colCount) + col];
+}
+
+inline bool CellularGrid::uses_planes() const
+{
+    return (populationLayout == StructureOfArrays) || (populationLayout == PaddedStructureOfArrays);
+}
+
+inline bool CellularGrid::uses_packed_cells() const
+{
+    return populationLayout == PackedCells;
+}
+
+inline Point CellularGrid::location_of(uint index) const
+{
+    return Point(index % colCount, index / colCount);
+}
+
+void CellularGrid::set_cell(uint row, uint col, const uchar r, const uchar g, const uchar b)
+{
+    if (uses_planes())
+        currentPlanes.set(currentPlanes.index(row, col), r, g, b);
+    else if (uses_packed_cells())
+        currentPackedCells[(row * colCount) + col] = PackedCell(r, g, b);
+    else
+        currentPopulation[(row * colCount) + col] = Cell(Point(col, row), r, g, b);
+}
+
+FitnessStatistics CellularGrid::compute_statistics() const
+{
+    FitnessStatistics result;
+#pragma omp parallel for reduction(merge_statistics : result)
+    for (uint row = 0; row < rowCount; row++)
+    {
+        if (uses_planes())
+        {
+            result.add_row(&currentPlanes.fitness[currentPlanes.index(row, 0)], colCount);
+            continue;
+        }
+        for (uint col = 0; col < colCount; col++)
+            result.add(uses_packed_cells() ? currentPackedCells[(row * colCount) + col].fitness() : currentPopulation[(row * colCount) + col].fitness);
+    }
+    return result;
+}
+
 CellularGrid::CellularGrid(const uint dimension)
 {
     colCount = dimension;
     rowCount = dimension;
+    tileRows = DEFAULT_TILE_SIZE;
+    tileCols = DEFAULT_TILE_SIZE;
+    temporalBlockDepth = 1;
+    snapshotFormat = BitmapSnapshots;
+    checkpointInterval = 0;
 }
 CellularGrid::CellularGrid(const uint width, const uint height)
 {
     rowCount = height;
     colCount = width;
+    tileRows = DEFAULT_TILE_SIZE;
+    tileCols = DEFAULT_TILE_SIZE;
+    temporalBlockDepth = 1;
+    snapshotFormat = BitmapSnapshots;
+    checkpointInterval = 0;
 }
 CellularGrid::~CellularGrid()
 {
     currentPopulation.clear();
     currentPopulation.shrink_to_fit();
+    offspringPopulation.clear();
+    offspringPopulation.shrink_to_fit();
+    currentPackedCells.clear();
+    currentPackedCells.shrink_to_fit();
+    offspringPackedCells.clear();
+    offspringPackedCells.shrink_to_fit();
 }
 
-void CellularGrid::initialize(const NeighborhoodType neighborhoodType, const PopulationMergeType mergeMethod, const InitializationType initType)
+// Sets the configuration and allocates the buffers of the population, which is filled by initialize() or restore_checkpoint().
+void CellularGrid::prepare_population(const NeighborhoodType neighborhoodType, const PopulationMergeType mergeMethod, const PopulationLayout layout, const uint64_t seed,
+                                      const UpdatePolicy updatePolicy)
 {
     this->neighborhoodMethod = neighborhoodType;
     this->mergeMethod = mergeMethod;
+    this->populationLayout = layout;
+    this->updatePolicy = updatePolicy;
+    this->seed = seed;
+    this->currentGeneration = 0;
     currentPopulation = std::vector<Cell>();
-    currentPopulation.resize(rowCount * colCount);
-
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<int> dis(0, 255); // Both ranges are inclusive.
+    offspringPopulation = std::vector<Cell>();
+    currentPlanes = PlanarPopulation();
+    offspringPlanes = PlanarPopulation();
+    currentPackedCells = PackedPopulation();
+    offspringPackedCells = PackedPopulation();
+    replaceTargets = std::vector<uint>();
+    replacementSlots = ReplacementSlots();
+    sweepOrder = std::vector<uint>();
+    sweepColoring = GridColoring();
+    tileActivity = TileActivity();
 
-    uchar r, g, b, discrimination;
-    Cell newCell;
-    uint index;
-    switch (initType)
+    // Both population buffers live for the whole run and swap roles every generation.
+    // Asynchronous updates replace cells in place and need no offspring buffer.
+    bool synchronous = (updatePolicy == SynchronousUpdate);
+    if (uses_planes())
     {
-    case RandomWithDiscrimination:
+        // Grids thinner than the halo are stored without it, kernels then gather neighborhoods with wrapping.
+        bool padded = (populationLayout == PaddedStructureOfArrays) && (rowCount >= HALO_SIZE) && (colCount >= HALO_SIZE);
+        uint halo = padded ? HALO_SIZE : 0;
+        currentPlanes.resize(rowCount, colCount, halo);
+        if (synchronous)
+            offspringPlanes.resize(rowCount, colCount, halo);
+        if (synchronous && (mergeMethod != ReplaceAll))
+        {
+            replaceTargets.resize(currentPlanes.plane_size());
+            replacementSlots.resize(currentPlanes.plane_size());
+        }
+    }
+    else if (uses_packed_cells())
     {
-#pragma omp parallel for private(r, g, b, discrimination)
-        for (uint row = 0; row < rowCount; row++)
+        currentPackedCells.resize(rowCount * colCount);
+        if (synchronous)
+            offspringPackedCells.resize(rowCount * colCount);
+        if (synchronous && (mergeMethod != ReplaceAll))
         {
-            for (uint col = 0; col < colCount; col++)
-            {
-                discrimination = (uchar)((row * col) % UCHAR_MAX_AS_INT);
-                r = (uchar)dis(gen);
-                g = (uchar)dis(gen);
-                b = (uchar)dis(gen);
+            replaceTargets.resize(currentPackedCells.size());
+            replacementSlots.resize(currentPackedCells.size());
+        }
+    }
+    else
+    {
+        currentPopulation.resize(rowCount * colCount);
+        if (synchronous)
+            offspringPopulation.resize(rowCount * colCount);
+        if (synchronous && (mergeMethod != ReplaceAll))
+            replacementSlots.resize(currentPopulation.size());
+    }
 
-                r = (r > discrimination) ? (uchar)(r - discrimination) : r;
-                g = (g > discrimination) ? (uchar)(g - discrimination) : g;
-                b = (b > discrimination) ? (uchar)(b - discrimination) : b;
+    // Random permutation of cells, drawn once and kept for the whole run.
+    if (updatePolicy == FixedRandomSweep)
+    {
+        sweepOrder.resize(rowCount * colCount);
+        for (uint i = 0; i < sweepOrder.size(); i++)
+            sweepOrder[i] = i;
 
-#pragma omp critical
-                {
-                    currentPopulation[(row * colCount) + col] = Cell(Point(col, row), r, g, b);
-                }
-            }
-        }
+        CounterRandom random(seed, 0, 0, 1);
+        for (size_t i = sweepOrder.size(); i > 1; i--)
+            std::swap(sweepOrder[i - 1], sweepOrder[random_below(random, (uint32_t)i)]);
     }
-    break;
-    case FitBorders:
+    if (updatePolicy == ColoredCellSweep)
+        sweepColoring = color_grid(neighborhoodMethod, mergeMethod, rowCount, colCount);
+}
+
+void CellularGrid::initialize(const NeighborhoodType neighborhoodType, const PopulationMergeType mergeMethod, const InitializationType initType, const PopulationLayout layout, const uint64_t seed,
+                              const UpdatePolicy updatePolicy)
+{
+    prepare_population(neighborhoodType, mergeMethod, layout, seed, updatePolicy);
+
+    // Initial population is generation 0, evolution starts with generation 1.
+    // Every cell is written exactly once, so rows are filled in parallel without locking.
+    uchar r, g, b;
+#pragma omp parallel for private(r, g, b)
+    for (uint row = 0; row < rowCount; row++)
     {
-        uint borderSize = rowCount / 15;
+        for (uint col = 0; col < colCount; col++)
+        {
+            initial_genome(initType, seed, row, col, rowCount, colCount, r, g, b);
+            set_cell(row, col, r, g, b);
+        }
+    }
+
+    if (uses_planes())
+        currentPlanes.refresh_halo();
+    statistics = compute_statistics();
+}
+
+uint64_t CellularGrid::get_seed() const
+{
+    return seed;
+}
+
+uint CellularGrid::get_current_generation() const
+{
+    return currentGeneration;
+}
+
+// Phase times of every generation are printed by evolve() while timing is enabled.
+void CellularGrid::set_phase_timing(const bool enabled)
+{
+    phaseTimers.set_enabled(enabled);
+}
+
+const PhaseTimers &CellularGrid::get_phase_timers() const
+{
+    return phaseTimers;
+}
+
+// evolve() saves a checkpoint every generationInterval generations, zero interval turns checkpointing off.
+void CellularGrid::set_checkpointing(const std::string &filename, const uint generationInterval)
+{
+    checkpointFilename = filename;
+    checkpointInterval = generationInterval;
+}
 
-#pragma omp parallel for private(r, g, b, newCell)
+void CellularGrid::save_checkpoint(const std::string &filename) const
+{
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CHECKPOINT_MAGIC;
+    header.version = CHECKPOINT_VERSION;
+    header.rowCount = rowCount;
+    header.colCount = colCount;
+    header.neighborhoodType = neighborhoodMethod;
+    header.mergeType = mergeMethod;
+    header.populationLayout = populationLayout;
+    header.updatePolicy = updatePolicy;
+    header.generation = currentGeneration;
+    header.seed = seed;
+    header.count = statistics.count;
+    header.sum = statistics.sum;
+    header.sumOfSquares = statistics.sumOfSquares;
+    header.optimalCount = statistics.optimalCount;
+    header.minFitness = statistics.min;
+    header.maxFitness = statistics.max;
+    layout_checkpoint(header);
+
+    // Planes are written row by row, planar layouts straight from their rows, the others through a row buffer.
+    CheckpointWriter writer(filename, header);
+    std::vector<uchar> channelRow(colCount);
+    std::vector<ushort> fitnessRow(colCount);
+    uint64_t planeOffsets[4] = {header.redOffset, header.greenOffset, header.blueOffset, header.fitnessOffset};
+    for (int plane = 0; plane < 4; plane++)
+    {
+        writer.begin_plane(planeOffsets[plane]);
         for (uint row = 0; row < rowCount; row++)
         {
-            for (uint col = 0; col < colCount; col++)
+            if (uses_planes())
             {
-                r = (uchar)dis(gen);
-                g = (uchar)dis(gen);
-                b = (uchar)dis(gen);
-
-                if ((row < borderSize) || (col < borderSize) || (row > (rowCount - borderSize)) || (col > (colCount - borderSize)))
-                {
-                    newCell = Cell(Point(col, row), r, g, b);
-                }
+                uint rowStart = currentPlanes.index(row, 0);
+                const Plane<uchar> *channels[3] = {&currentPlanes.R, &currentPlanes.G, &currentPlanes.B};
+                if (plane == 3)
+                    writer.write(&currentPlanes.fitness[rowStart], colCount * sizeof(ushort));
                 else
-                {
-                    newCell = Cell(Point(col, row), 1, 1, 1);
-                }
+                    writer.write(channels[plane]->data() + rowStart, colCount);
+                continue;
+            }
 
-#pragma omp critical
-                {
-                    currentPopulation[(row * colCount) + col] = newCell;
-                }
+            for (uint col = 0; col < colCount; col++)
+            {
+                Cell cell = get_cell(row, col);
+                uchar channels[3] = {cell.R, cell.G, cell.B};
+                if (plane == 3)
+                    fitnessRow[col] = cell.fitness;
+                else
+                    channelRow[col] = channels[plane];
             }
+            if (plane == 3)
+                writer.write(fitnessRow.data(), colCount * sizeof(ushort));
+            else
+                writer.write(channelRow.data(), colCount);
         }
     }
-    break;
-    case FitCorner:
+    writer.commit();
+}
+
+// Replaces dimensions, configuration and population of the grid with those of the checkpoint, evolve() then continues
+// with the following generation. Planes are copied out of the mapped file without any decoding, statistics are taken over as well.
+void CellularGrid::restore_checkpoint(const std::string &filename)
+{
+    std::shared_ptr<MappedCheckpoint> checkpoint = std::make_shared<MappedCheckpoint>(filename);
+    const CheckpointHeader &header = checkpoint->header();
+    if ((header.neighborhoodType > C13) || (header.mergeType > ReplaceOneParent) || (header.populationLayout > PackedCells) || (header.updatePolicy > ColoredCellSweep))
+        throw std::runtime_error(filename + " has unknown configuration.");
+
+    rowCount = header.rowCount;
+    colCount = header.colCount;
+    prepare_population((NeighborhoodType)header.neighborhoodType, (PopulationMergeType)header.mergeType, (PopulationLayout)header.populationLayout, header.seed,
+                       (UpdatePolicy)header.updatePolicy);
+    currentGeneration = header.generation;
+
+    // Unpadded planes are laid out like the checkpoint planes, so they use the mapping itself and its pages are read
+    // as the evolution first touches them. Checkpoints are saved by renaming a new file, so the mapping survives that.
+    // Padded planes and cell layouts are copied out of the checkpoint.
+    if (uses_planes() && (currentPlanes.halo == 0))
+    {
+        size_t cellCount = currentPlanes.size();
+        currentPlanes.R.map(checkpoint->writable_plane(header.redOffset), cellCount, checkpoint);
+        currentPlanes.G.map(checkpoint->writable_plane(header.greenOffset), cellCount, checkpoint);
+        currentPlanes.B.map(checkpoint->writable_plane(header.blueOffset), cellCount, checkpoint);
+        currentPlanes.fitness.map((ushort *)checkpoint->writable_plane(header.fitnessOffset), cellCount, checkpoint);
+    }
+    else
     {
-        uint borderSize = rowCount / 10;
+        const uchar *red = checkpoint->red();
+        const uchar *green = checkpoint->green();
+        const uchar *blue = checkpoint->blue();
+        const ushort *fitness = checkpoint->fitness();
 
-#pragma omp parallel for private(r, g, b, newCell)
+#pragma omp parallel for
         for (uint row = 0; row < rowCount; row++)
         {
-            for (uint col = 0; col < colCount; col++)
+            size_t rowStart = (size_t)row * colCount;
+            if (uses_planes())
             {
-                r = (uchar)dis(gen);
-                g = (uchar)dis(gen);
-                b = (uchar)dis(gen);
-
-                if ((row < borderSize) && (col < borderSize))
-                {
-                    newCell = Cell(Point(col, row), r, g, b);
-                }
-                else
-                {
-                    newCell = Cell(Point(col, row), 1, 1, 1);
-                }
-#pragma omp critical
-                {
-                    currentPopulation[(row * colCount) + col] = newCell;
-                }
+                uint planeRowStart = currentPlanes.index(row, 0);
+                std::copy(red + rowStart, red + rowStart + colCount, currentPlanes.R.begin() + planeRowStart);
+                std::copy(green + rowStart, green + rowStart + colCount, currentPlanes.G.begin() + planeRowStart);
+                std::copy(blue + rowStart, blue + rowStart + colCount, currentPlanes.B.begin() + planeRowStart);
+                std::copy(fitness + rowStart, fitness + rowStart + colCount, currentPlanes.fitness.begin() + planeRowStart);
+                continue;
             }
+            for (uint col = 0; col < colCount; col++)
+                set_cell(row, col, red[rowStart + col], green[rowStart + col], blue[rowStart + col]);
         }
+        if (uses_planes())
+            currentPlanes.refresh_halo();
     }
-    break;
-    default:
-        assert(false && "Wrong initialization type.");
-    }
+
+    statistics = FitnessStatistics();
+    statistics.count = header.count;
+    statistics.sum = header.sum;
+    statistics.sumOfSquares = header.sumOfSquares;
+    statistics.optimalCount = header.optimalCount;
+    statistics.min = (ushort)header.minFitness;
+    statistics.max = (ushort)header.maxFitness;
+}
+
+// Tile size used by the WorkStealingTiles threading model.
+void CellularGrid::set_tile_size(const uint tileRows, const uint tileCols)
+{
+    assert(tileRows > 0 && tileCols > 0);
+    this->tileRows = tileRows;
+    this->tileCols = tileCols;
+}
+
+// Number of generations evolved per tile before it is written back.
+// Temporal blocking is used for the synchronous ReplaceAll model on planar layouts, other configurations ignore it.
+void CellularGrid::set_temporal_blocking(const uint generationsPerBlock)
+{
+    assert(generationsPerBlock > 0);
+    temporalBlockDepth = generationsPerBlock;
+}
+
+// Images saved by evolve() are either separate BMP files or frames of a single stream, see frame_stream.h.
+void CellularGrid::set_snapshot_format(const SnapshotFormat format)
+{
+    snapshotFormat = format;
+}
+
+bool CellularGrid::uses_temporal_blocking() const
+{
+    return (temporalBlockDepth > 1) && (updatePolicy == SynchronousUpdate) && (mergeMethod == ReplaceAll) && uses_planes();
 }
 
 double CellularGrid::get_score_of_generation() const
 {
-    double sum = 0.0;
+    assert(statistics.count == (uint64_t)rowCount * colCount);
+    return statistics.mean() / MAX_FITNESS_VALUE;
+}
 
-    for (size_t i = 0; i < currentPopulation.size(); i++)
-    {
-        assert(currentPopulation[i].get_fitness() <= MAX_FITNESS_VALUE);
-        sum += currentPopulation[i].get_fitness();
-    }
-    double result = (sum / (double)currentPopulation.size()) / MAX_FITNESS_VALUE;
-    return result;
+const FitnessStatistics &CellularGrid::get_statistics_of_generation() const
+{
+    return statistics;
 }
 
-void CellularGrid::dump_current_population_to_image(const std::string &folder, uint generation, bool bw)
+// Copies the grid into the snapshot, either normalized fitness (bw) or the RGB genome.
+void CellularGrid::capture_snapshot(Snapshot &snapshot, const uint generation, const bool bw) const
 {
-    cimg_library::CImg<uchar> gridImage;
-    if (bw)
-        gridImage = create_grayscale_image(colCount, rowCount);
-    else
-        gridImage = create_color_image(colCount, rowCount);
+    snapshot.generation = generation;
+    snapshot.resize(colCount, rowCount, bw ? 1 : 3);
 
+#pragma omp parallel for
     for (uint row = 0; row < rowCount; row++)
     {
         for (uint col = 0; col < colCount; col++)
         {
-            Cell cell = at(row, col);
+            Cell cell = get_cell(row, col);
+            size_t pixel = ((size_t)row * colCount) + col;
             if (bw)
             {
-                uchar normalized = (uchar)((cell.get_fitness() / MAX_FITNESS_VALUE) * 255.0f);
-                set_pixel(gridImage, row, col, normalized);
+                snapshot.channel(0)[pixel] = (uchar)((cell.get_fitness() / MAX_FITNESS_VALUE) * 255.0f);
             }
             else
             {
-                set_pixel(gridImage, row, col, RgbPixel(cell.R, cell.G, cell.B));
+                snapshot.channel(0)[pixel] = cell.R;
+                snapshot.channel(1)[pixel] = cell.G;
+                snapshot.channel(2)[pixel] = cell.B;
             }
         }
     }
+}
 
-    std::string filename = folder + "/generation_" + std::to_string(generation) + ".bmp";
-    gridImage.save_bmp(filename.c_str());
+void save_snapshot(const Snapshot &snapshot, const std::string &folder)
+{
+    std::string filename = folder + "/generation_" + std::to_string(snapshot.generation) + ".bmp";
+    save_bmp(filename, snapshot.pixels.data(), snapshot.width, snapshot.height, snapshot.channelCount);
+}
+
+void CellularGrid::dump_current_population_to_image(const std::string &folder, uint generation, bool bw)
+{
+    Snapshot snapshot;
+    capture_snapshot(snapshot, generation, bw);
+    save_snapshot(snapshot, folder);
 }
 
-void CellularGrid::evolve(const int maxGenerationCount, const bool multiThreaded, const int threadCount, const bool saveImages, const std::string &folder)
+void CellularGrid::evolve(const int maxGenerationCount, const bool multiThreaded, const int threadCount, const bool saveImages, const std::string &folder,
+                          const ThreadingModel threadingModel)
 {
     double generationScore = get_score_of_generation();
     printf("Chosen neighborhood: %s\nChosen merge method: %s\n", std::to_string(neighborhoodMethod).c_str(), std::to_string(mergeMethod).c_str());
+    printf("Seed: %llu\n", (unsigned long long)seed);
+    if (updatePolicy == ColoredCellSweep)
+        printf("Sweep colors: %u\n", sweepColoring.colorCount);
     printf("Initial generation score: %f\n", generationScore);
 
+    // Pool threads live for the whole run.
+    bool usePool = multiThreaded && (threadingModel != OpenMPThreads);
+    if (usePool)
+        workerPool.reset(new WorkerPool(threadCount));
+
+    // Images are written by the snapshot thread while the next generations evolve.
+    // Snapshot writer is declared last, so it finishes the queued frames before the stream is closed.
+    std::unique_ptr<FrameStreamWriter> frameStream;
+    std::unique_ptr<SnapshotWriter> snapshotWriter;
+    if (saveImages && (snapshotFormat == FrameStreamSnapshots))
+    {
+        // Restored or extended run continues the stream of the generations before it.
+        frameStream.reset(new FrameStreamWriter(folder + "/generations.frames", DEFAULT_KEYFRAME_INTERVAL, currentGeneration));
+        FrameStreamWriter *stream = frameStream.get();
+        snapshotWriter.reset(new SnapshotWriter([stream](const Snapshot &snapshot) { stream->write(snapshot); }));
+    }
+    else if (saveImages)
+    {
+        snapshotWriter.reset(new SnapshotWriter([folder](const Snapshot &snapshot) { save_snapshot(snapshot, folder); }));
+    }
+
     StopwatchData s;
     double time;
-    for (int generation = 1; generation <= maxGenerationCount; generation++)
+    int stepGenerationCount = 1;
+    for (int generation = (int)currentGeneration + 1; generation <= maxGenerationCount; generation += stepGenerationCount)
     {
+        currentGeneration = generation;
+        stepGenerationCount = 1;
         start_stopwatch(s);
-        if (multiThreaded)
-            openmp_evolution_step(threadCount); //multithreaded_evolution_step(threadCount);
+        if (uses_temporal_blocking())
+        {
+            stepGenerationCount = std::min((int)temporalBlockDepth, maxGenerationCount - generation + 1);
+            temporal_blocking_step(stepGenerationCount, multiThreaded ? threadCount : 1);
+        }
+        else if (updatePolicy != SynchronousUpdate)
+            asynchronous_evolution_step(multiThreaded ? threadCount : 1);
+        else if (usePool && (threadingModel == WorkStealingTiles))
+            tiled_evolution_step();
+        else if (usePool)
+            multithreaded_evolution_step();
+        else if (uses_planes())
+            planar_evolution_step(multiThreaded ? threadCount : 1);
+        else if (multiThreaded)
+            openmp_evolution_step(threadCount);
         else
             synchronous_evolution_step();
         stop_stopwatch(s);
 
         time = elapsed_milliseconds(s);
+        uint64_t phaseStart = phaseTimers.start();
         generationScore = get_score_of_generation();
+        phaseTimers.stop(ScoringPhase, phaseStart);
+        int lastGeneration = generation + stepGenerationCount - 1;
 
-        printf("Completed generation %i; Score: %f; Iteration time %f ms\n", generation, generationScore, time);
+        printf("Completed generation %i; Score: %f; Fitness min %u, max %u, variance %f; Iteration time %f ms\n",
+               lastGeneration, generationScore, statistics.min, statistics.max, statistics.variance(), time);
 
         if (saveImages)
-            dump_current_population_to_image(folder, generation, true);
+        {
+            PhaseTimer timer(phaseTimers, SnapshotPhase);
+            Snapshot &snapshot = snapshotWriter->acquire();
+            capture_snapshot(snapshot, lastGeneration, true);
+            snapshotWriter->submit(snapshot);
+        }
+
+        if (phaseTimers.is_enabled())
+        {
+            phaseTimers.collect();
+            phaseTimers.print_generation();
+        }
 
-        if (generationScore == 1.0)
+        // Last generation of the run is saved too, so that the run can be extended later.
+        bool converged = statistics.optimalCount == statistics.count;
+        bool intervalCrossed = (checkpointInterval > 0) && ((lastGeneration / checkpointInterval) != ((generation - 1) / checkpointInterval));
+        if ((checkpointInterval > 0) && (intervalCrossed || converged || (lastGeneration == maxGenerationCount)))
+            save_checkpoint(checkpointFilename);
+
+        if (converged)
         {
             printf("Target objective was reached.\n");
-            return;
+            break;
         }
     }
+    workerPool.reset();
+
+    // Failed image write ends the run with an error instead of leaving missing or damaged images behind.
+    if (snapshotWriter)
+        snapshotWriter->finish();
 }
 
-void CellularGrid::synchronous_evolution_step()
+template <NeighborhoodType Type, PopulationMergeType Merge>
+FitnessStatistics CellularGrid::evolve_cell_rows(const uint rowFrom, const uint rowTo, const uint colFrom, const uint colTo)
+{
+    uint64_t phaseStart = phaseTimers.start();
+    FitnessStatistics offspringStatistics;
+    for (uint row = rowFrom; row < rowTo; row++)
+    {
+        Cell *offspringRow = offspringPopulation.data() + (row * colCount);
+        for_each_neighborhood_in_row<Type>(currentPopulation, row, colFrom, colTo, rowCount, colCount, [&](const uint col, const Neighborhood &neighborhood) {
+            CounterRandom random(seed, currentGeneration, (row * colCount) + col);
+            std::pair<uint, uint> parents = select_parents(neighborhood, random);
+            Cell offspring = reproduction(col, row, std::make_pair(currentPopulation[parents.first], currentPopulation[parents.second]), random_below(random, 3));
+
+            if constexpr (Merge == ReplaceWorstInNeighborhood)
+                offspring.cellToReplaceLocation = location_of(get_worst_cell_index(neighborhood));
+            else if constexpr (Merge == ReplaceOneParent)
+                offspring.cellToReplaceLocation = location_of((random_below(random, 2) == 0) ? parents.first : parents.second);
+
+            offspringRow[col] = offspring;
+            offspringStatistics.add(offspring.fitness);
+        });
+    }
+    phaseTimers.stop(BreedingPhase, phaseStart);
+    return offspringStatistics;
+}
+
+template <NeighborhoodType Type, PopulationMergeType Merge>
+FitnessStatistics CellularGrid::evolve_planar_rows(const uint rowFrom, const uint rowTo, const uint colFrom, const uint colTo)
 {
-    std::vector<Cell> newPopulation;
-    newPopulation.resize(rowCount * colCount);
+    // Rows are selected in batches of cells, then the parent genomes of the whole row are reproduced with SIMD byte max.
+    thread_local ParentRows parentRows;
+    thread_local NeighborhoodBatch<Type> batch;
+    parentRows.resize(colCount);
 
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<int> dis012(0, 2); // Both ranges are inclusive.
-    std::uniform_int_distribution<int> dis01(0, 1);  // Both ranges are inclusive.
-    int random;
-    for (uint row = 0; row < rowCount; row++)
+    FitnessStatistics offspringStatistics;
+    for (uint row = rowFrom; row < rowTo; row++)
     {
-        for (uint col = 0; col < colCount; col++)
+        uint rowStart = currentPlanes.index(row, 0);
+        for (uint batchFrom = colFrom; batchFrom < colTo; batchFrom += SELECTION_BATCH)
         {
-            std::vector<Cell> neighborhood = get_neighborhood(row, col);
-            std::pair<Cell, Cell> parents = select_parents(neighborhood);
-            Cell offspring = reproduction(col, row, parents, dis012(gen));
+            uint batchTo = std::min(batchFrom + SELECTION_BATCH, colTo);
+            uint count = batchTo - batchFrom;
+            uint64_t phaseStart = phaseTimers.start();
 
-            if (mergeMethod == ReplaceWorstInNeighborhood)
+            auto gather_cell = [&](const uint col, const Neighborhood &neighborhood) {
+                batch.set(col - batchFrom, neighborhood);
+            };
+            if (currentPlanes.halo >= Stencil<Type>::radius)
+                for_each_neighborhood_in_padded_row<Type>(currentPlanes, rowStart, batchFrom, batchTo, currentPlanes.stride, gather_cell);
+            else
+                for_each_neighborhood_in_row<Type>(currentPlanes, row, batchFrom, batchTo, rowCount, colCount, gather_cell);
+            phaseStart = phaseTimers.lap(GatherPhase, phaseStart);
+
+            // Same order of draws as the cell layout: both parents, rotation, replaced parent.
+            uint32_t rotationDraws[SELECTION_BATCH];
+            uint32_t replaceDraws[SELECTION_BATCH];
+            for (uint lane = 0; lane < count; lane++)
             {
-                offspring.cellToReplaceLocation = get_worst_cell(neighborhood).cellLocation;
+                CounterRandom random(seed, currentGeneration, (row * colCount) + batchFrom + lane);
+                batch.drawA[lane] = random();
+                batch.drawB[lane] = random();
+                rotationDraws[lane] = random();
+                replaceDraws[lane] = random();
             }
-            else if (mergeMethod == ReplaceOneParent)
+
+            select_parents_batch(batch, count);
+            if constexpr (Merge == ReplaceWorstInNeighborhood)
+                select_worst_batch(batch, count);
+
+            for (uint lane = 0; lane < count; lane++)
             {
-                random = dis01(gen);
-                offspring.cellToReplaceLocation = (random == 0) ? parents.first.cellLocation : parents.second.cellLocation;
+                uint col = batchFrom + lane;
+                uint first = batch.index[batch.slotA[lane]][lane];
+                uint second = batch.index[batch.slotB[lane]][lane];
+
+                parentRows.firstR[col] = currentPlanes.R[first];
+                parentRows.firstG[col] = currentPlanes.G[first];
+                parentRows.firstB[col] = currentPlanes.B[first];
+                parentRows.secondR[col] = currentPlanes.R[second];
+                parentRows.secondG[col] = currentPlanes.G[second];
+                parentRows.secondB[col] = currentPlanes.B[second];
+                parentRows.rotation[col] = (uchar)scale_draw(rotationDraws[lane], 3);
+
+                if constexpr (Merge == ReplaceWorstInNeighborhood)
+                    replaceTargets[rowStart + col] = batch.index[batch.worstSlot[lane]][lane];
+                else if constexpr (Merge == ReplaceOneParent)
+                    replaceTargets[rowStart + col] = (scale_draw(replaceDraws[lane], 2) == 0) ? first : second;
             }
-            newPopulation[(row * colCount) + col] = offspring;
+            phaseTimers.stop(SelectionPhase, phaseStart);
         }
+
+        uint64_t phaseStart = phaseTimers.start();
+        reproduce_row(parentRows, colFrom, colTo,
+                      &offspringPlanes.R[rowStart], &offspringPlanes.G[rowStart], &offspringPlanes.B[rowStart], &offspringPlanes.fitness[rowStart]);
+        phaseStart = phaseTimers.lap(ReproductionPhase, phaseStart);
+        offspringStatistics.add_row(&offspringPlanes.fitness[rowStart + colFrom], colTo - colFrom);
+        phaseTimers.stop(ScoringPhase, phaseStart);
     }
-    currentPopulation = replace(rowCount, colCount, currentPopulation, newPopulation, mergeMethod);
+    return offspringStatistics;
 }
 
-std::vector<Cell> CellularGrid::get_neighborhood(const uint row, const uint col)
+template <NeighborhoodType Type, PopulationMergeType Merge>
+FitnessStatistics CellularGrid::evolve_packed_rows(const uint rowFrom, const uint rowTo, const uint colFrom, const uint colTo)
 {
-    std::vector<Cell> neighborhood;
-    switch (neighborhoodMethod)
-    {
-    case L5:
+    uint64_t phaseStart = phaseTimers.start();
+    FitnessStatistics offspringStatistics;
+    for (uint row = rowFrom; row < rowTo; row++)
     {
-        neighborhood.reserve(5);
-
-        neighborhood.push_back(at(row, col));
+        uint rowStart = row * colCount;
+        for_each_neighborhood_in_row<Type>(currentPackedCells, row, colFrom, colTo, rowCount, colCount, [&](const uint col, const Neighborhood &neighborhood) {
+            CounterRandom random(seed, currentGeneration, rowStart + col);
+            std::pair<uint, uint> parents = select_parents(neighborhood, random);
+            PackedCell offspring = reproduction(currentPackedCells[parents.first], currentPackedCells[parents.second], random_below(random, 3));
 
-        neighborhood.push_back(at(row, mod(col - 1, colCount))); // Left
-        neighborhood.push_back(at(mod(row - 1, rowCount), col)); // Top
-        neighborhood.push_back(at(row, mod(col + 1, colCount))); // Right
-        neighborhood.push_back(at(mod(row + 1, rowCount), col)); // Bottom
+            if constexpr (Merge == ReplaceWorstInNeighborhood)
+                replaceTargets[rowStart + col] = get_worst_cell_index(neighborhood);
+            else if constexpr (Merge == ReplaceOneParent)
+                replaceTargets[rowStart + col] = (random_below(random, 2) == 0) ? parents.first : parents.second;
 
-        assert(neighborhood.size() == 5);
-        return neighborhood;
+            offspringPackedCells[rowStart + col] = offspring;
+            offspringStatistics.add(offspring.fitness());
+        });
     }
-    break;
-    case L9:
-    {
-        neighborhood.reserve(9);
+    phaseTimers.stop(BreedingPhase, phaseStart);
+    return offspringStatistics;
+}
 
-        neighborhood.push_back(at(row, col));
-        neighborhood.push_back(at(row, mod(col - 1, colCount))); // Left
-        neighborhood.push_back(at(row, mod(col - 2, colCount))); // Left 2
-        neighborhood.push_back(at(mod(row - 1, rowCount), col)); // Top
-        neighborhood.push_back(at(mod(row - 2, rowCount), col)); // Top 2
-        neighborhood.push_back(at(row, mod(col + 1, colCount))); // Right
-        neighborhood.push_back(at(row, mod(col + 2, colCount))); // Right 2
-        neighborhood.push_back(at(mod(row + 1, rowCount), col)); // Bottom
-        neighborhood.push_back(at(mod(row + 2, rowCount), col)); // Bottom 2
+template <NeighborhoodType Type>
+FitnessStatistics CellularGrid::evolve_temporal_block(const uint rowFrom, const uint rowTo, const uint colFrom, const uint colTo, const uint generationCount)
+{
+    // Tile is loaded with a margin of generationCount stencil radii. Every generation the part of the block
+    // with a complete neighborhood shrinks by one radius, after the last generation it is exactly the tile.
+    constexpr uint radius = Stencil<Type>::radius;
+    thread_local PlanarPopulation block;
+    thread_local PlanarPopulation nextBlock;
 
-        assert(neighborhood.size() == 9);
-        return neighborhood;
+    const uint margin = generationCount * radius;
+    const uint blockRows = (rowTo - rowFrom) + (2 * margin);
+    const uint blockCols = (colTo - colFrom) + (2 * margin);
+    if ((block.rowCount != blockRows) || (block.colCount != blockCols))
+    {
+        block.resize(blockRows, blockCols);
+        nextBlock.resize(blockRows, blockCols);
     }
-    break;
-    case C9:
+
+    thread_local std::vector<uint> gridCols;
+    gridCols.resize(blockCols);
+    for (uint col = 0; col < blockCols; col++)
+        gridCols[col] = positive_mod((int)(colFrom + col) - (int)margin, (int)colCount);
+
+    for (uint row = 0; row < blockRows; row++)
     {
-        neighborhood.reserve(9);
+        uint gridRow = positive_mod((int)(rowFrom + row) - (int)margin, (int)rowCount);
+        for (uint col = 0; col < blockCols; col++)
+            block.copy_cell(block.index(row, col), currentPlanes, currentPlanes.index(gridRow, gridCols[col]));
+    }
 
-        // When this was calculated in for cycles, OpenMp didn't execute them.
-        int fromRow = row - 1;
-        int toRow = row + 2;
-        int fromCol = col - 1;
-        int toCol = col + 2;
+    // Cells draw from the stream of their grid index and generation, so the offspring are those of the generation by generation engine.
+    // Block rows are evolved in the same way as rows of evolve_planar_rows().
+    thread_local ParentRows parentRows;
+    thread_local NeighborhoodBatch<Type> batch;
+    parentRows.resize(blockCols);
 
-        for (int nRow = fromRow; nRow < toRow; nRow++)
+    for (uint step = 1; step <= generationCount; step++)
+    {
+        uint generation = currentGeneration + step - 1;
+        uint validFrom = step * radius;
+        uint validColTo = blockCols - validFrom;
+        for (uint row = validFrom; row < blockRows - validFrom; row++)
         {
-            for (int nCol = fromCol; nCol < toCol; nCol++)
+            uint rowStart = block.index(row, 0);
+            uint gridRowStart = positive_mod((int)(rowFrom + row) - (int)margin, (int)rowCount) * colCount;
+            for (uint batchFrom = validFrom; batchFrom < validColTo; batchFrom += SELECTION_BATCH)
             {
-                neighborhood.push_back(at(mod(nRow, rowCount), mod(nCol, colCount)));
+                uint count = std::min(SELECTION_BATCH, validColTo - batchFrom);
+                uint64_t phaseStart = phaseTimers.start();
+                for (uint lane = 0; lane < count; lane++)
+                    batch.set(lane, gather_interior<Type>(block, rowStart + batchFrom + lane, blockCols));
+                phaseStart = phaseTimers.lap(GatherPhase, phaseStart);
+
+                uint32_t rotationDraws[SELECTION_BATCH];
+                for (uint lane = 0; lane < count; lane++)
+                {
+                    uint col = batchFrom + lane;
+                    CounterRandom random(seed, generation, gridRowStart + gridCols[col]);
+                    batch.drawA[lane] = random();
+                    batch.drawB[lane] = random();
+                    rotationDraws[lane] = random();
+                }
+
+                select_parents_batch(batch, count);
+
+                for (uint lane = 0; lane < count; lane++)
+                {
+                    uint col = batchFrom + lane;
+                    uint first = batch.index[batch.slotA[lane]][lane];
+                    uint second = batch.index[batch.slotB[lane]][lane];
+
+                    parentRows.firstR[col] = block.R[first];
+                    parentRows.firstG[col] = block.G[first];
+                    parentRows.firstB[col] = block.B[first];
+                    parentRows.secondR[col] = block.R[second];
+                    parentRows.secondG[col] = block.G[second];
+                    parentRows.secondB[col] = block.B[second];
+                    parentRows.rotation[col] = (uchar)scale_draw(rotationDraws[lane], 3);
+                }
+                phaseTimers.stop(SelectionPhase, phaseStart);
             }
+
+            uint64_t phaseStart = phaseTimers.start();
+            reproduce_row(parentRows, validFrom, validColTo,
+                          &nextBlock.R[rowStart], &nextBlock.G[rowStart], &nextBlock.B[rowStart], &nextBlock.fitness[rowStart]);
+            phaseTimers.stop(ReproductionPhase, phaseStart);
         }
+        block.swap(nextBlock);
+    }
 
-        assert(neighborhood.size() == 9);
-        return neighborhood;
+    // Writing the tile back replaces the population, together with its statistics.
+    uint64_t phaseStart = phaseTimers.start();
+    FitnessStatistics offspringStatistics;
+    for (uint row = rowFrom; row < rowTo; row++)
+    {
+        uint rowStart = offspringPlanes.index(row, colFrom);
+        uint blockRowStart = block.index(row - rowFrom + margin, margin);
+        for (uint col = 0; col < colTo - colFrom; col++)
+            offspringPlanes.copy_cell(rowStart + col, block, blockRowStart + col);
+        offspringStatistics.add_row(&offspringPlanes.fitness[rowStart], colTo - colFrom);
     }
-    break;
-    case C13:
+    phaseTimers.stop(ReplacementPhase, phaseStart);
+    return offspringStatistics;
+}
+
+CellularGrid::TemporalBlockKernel CellularGrid::select_temporal_block_kernel() const
+{
+    switch (neighborhoodMethod)
     {
-        neighborhood.reserve(13);
+    case L5:
+        return &CellularGrid::evolve_temporal_block<L5>;
+    case L9:
+        return &CellularGrid::evolve_temporal_block<L9>;
+    case C9:
+        return &CellularGrid::evolve_temporal_block<C9>;
+    case C13:
+        return &CellularGrid::evolve_temporal_block<C13>;
+    default:
+        assert(false && "Wrong method");
+        return nullptr;
+    }
+}
+
+template <NeighborhoodType Type, PopulationMergeType Merge, typename Population>
+void CellularGrid::update_in_place(Population &population, const uint row, const uint colFrom, const uint colTo)
+{
+    // Neighborhoods are gathered one cell at a time, so every cell sees offspring placed before it.
+    auto update_cell = [&](const uint col, const Neighborhood &neighborhood) {
+        CounterRandom random(seed, currentGeneration, (row * colCount) + col);
+        std::pair<uint, uint> parents = select_parents(neighborhood, random);
+        Cell offspring = reproduction(col, row, std::make_pair(genome_at(population, parents.first), genome_at(population, parents.second)), random_below(random, 3));
+
+        uint target;
+        if constexpr (Merge == ReplaceAll)
+            target = neighborhood.index[Stencil<Type>::center];
+        else if constexpr (Merge == ReplaceWorstInNeighborhood)
+            target = get_worst_cell_index(neighborhood);
+        else
+            target = (random_below(random, 2) == 0) ? parents.first : parents.second;
 
-        // When this was calculated in for cycles, OpenMp didn't execute them.
-        int fromRow = row - 1;
-        int toRow = row + 2;
-        int fromCol = col - 1;
-        int toCol = col + 2;
+        store_genome(population, target, offspring.R, offspring.G, offspring.B);
+    };
 
-        for (int nRow = fromRow; nRow < toRow; nRow++)
+    if constexpr (std::is_same<Population, PlanarPopulation>::value)
+    {
+        if (population.halo >= Stencil<Type>::radius)
         {
-            for (int nCol = fromCol; nCol < toCol; nCol++)
-            {
-                neighborhood.push_back(at(mod(nRow, rowCount), mod(nCol, colCount)));
-            }
+            for_each_neighborhood_in_padded_row<Type>(population, population.index(row, 0), colFrom, colTo, population.stride, update_cell);
+            return;
         }
-        neighborhood.push_back(at(row, mod(col - 2, colCount))); // Left 2
-        neighborhood.push_back(at(mod(row - 2, rowCount), col)); // Top 2
-        neighborhood.push_back(at(row, mod(col + 2, colCount))); // Right 2
-        neighborhood.push_back(at(mod(row + 2, rowCount), col)); // Bottom 2
+    }
+    for_each_neighborhood_in_row<Type>(population, row, colFrom, colTo, rowCount, colCount, update_cell);
+}
+
+template <NeighborhoodType Type, PopulationMergeType Merge>
+void CellularGrid::sweep(const uint *order, const uint from, const uint to)
+{
+    PhaseTimer timer(phaseTimers, BreedingPhase);
+    for (uint i = from; i < to; i++)
+    {
+        uint row = (order != nullptr) ? (order[i] / colCount) : i;
+        uint colFrom = (order != nullptr) ? (order[i] % colCount) : 0;
+        uint colTo = (order != nullptr) ? (colFrom + 1) : colCount;
 
-        assert(neighborhood.size() == 13);
-        return neighborhood;
+        if (uses_planes())
+            update_in_place<Type, Merge>(currentPlanes, row, colFrom, colTo);
+        else if (uses_packed_cells())
+            update_in_place<Type, Merge>(currentPackedCells, row, colFrom, colTo);
+        else
+            update_in_place<Type, Merge>(currentPopulation, row, colFrom, colTo);
     }
-    break;
+}
+
+template <NeighborhoodType Type>
+CellularGrid::SweepKernel CellularGrid::select_sweep_kernel() const
+{
+    switch (mergeMethod)
+    {
+    case ReplaceAll:
+        return &CellularGrid::sweep<Type, ReplaceAll>;
+    case ReplaceWorstInNeighborhood:
+        return &CellularGrid::sweep<Type, ReplaceWorstInNeighborhood>;
+    case ReplaceOneParent:
+        return &CellularGrid::sweep<Type, ReplaceOneParent>;
     default:
+        assert(false && "Wrong merge method.");
+        return nullptr;
+    }
+}
+
+CellularGrid::SweepKernel CellularGrid::select_sweep_kernel() const
+{
+    switch (neighborhoodMethod)
     {
+    case L5:
+        return select_sweep_kernel<L5>();
+    case L9:
+        return select_sweep_kernel<L9>();
+    case C9:
+        return select_sweep_kernel<C9>();
+    case C13:
+        return select_sweep_kernel<C13>();
+    default:
         assert(false && "Wrong method");
+        return nullptr;
     }
+}
+
+template <NeighborhoodType Type>
+CellularGrid::RowsKernel CellularGrid::select_cell_kernel() const
+{
+    switch (mergeMethod)
+    {
+    case ReplaceAll:
+        return &CellularGrid::evolve_cell_rows<Type, ReplaceAll>;
+    case ReplaceWorstInNeighborhood:
+        return &CellularGrid::evolve_cell_rows<Type, ReplaceWorstInNeighborhood>;
+    case ReplaceOneParent:
+        return &CellularGrid::evolve_cell_rows<Type, ReplaceOneParent>;
+    default:
+        assert(false && "Wrong merge method.");
+        return nullptr;
     }
 }
 
-void CellularGrid::worker_job(int rowFrom, int rowTo, std::vector<Cell> &result)
+CellularGrid::RowsKernel CellularGrid::select_cell_kernel() const
 {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<int> dis012(0, 2); // Both ranges are inclusive.
-    std::uniform_int_distribution<int> dis01(0, 1);  // Both ranges are inclusive.
+    switch (neighborhoodMethod)
+    {
+    case L5:
+        return select_cell_kernel<L5>();
+    case L9:
+        return select_cell_kernel<L9>();
+    case C9:
+        return select_cell_kernel<C9>();
+    case C13:
+        return select_cell_kernel<C13>();
+    default:
+        assert(false && "Wrong method");
+        return nullptr;
+    }
+}
 
-    Cell offspring;
-    std::vector<Cell> neighborhood;
-    std::pair<Cell, Cell> parents;
+template <NeighborhoodType Type>
+CellularGrid::RowsKernel CellularGrid::select_planar_kernel() const
+{
+    switch (mergeMethod)
+    {
+    case ReplaceAll:
+        return &CellularGrid::evolve_planar_rows<Type, ReplaceAll>;
+    case ReplaceWorstInNeighborhood:
+        return &CellularGrid::evolve_planar_rows<Type, ReplaceWorstInNeighborhood>;
+    case ReplaceOneParent:
+        return &CellularGrid::evolve_planar_rows<Type, ReplaceOneParent>;
+    default:
+        assert(false && "Wrong merge method.");
+        return nullptr;
+    }
+}
 
-    //  std::vector<Cell> result;
+CellularGrid::RowsKernel CellularGrid::select_planar_kernel() const
+{
+    switch (neighborhoodMethod)
+    {
+    case L5:
+        return select_planar_kernel<L5>();
+    case L9:
+        return select_planar_kernel<L9>();
+    case C9:
+        return select_planar_kernel<C9>();
+    case C13:
+        return select_planar_kernel<C13>();
+    default:
+        assert(false && "Wrong method");
+        return nullptr;
+    }
+}
 
-    result.reserve((rowTo - rowFrom) * colCount);
-    int index = 0;
-    int random;
+template <NeighborhoodType Type>
+CellularGrid::RowsKernel CellularGrid::select_packed_kernel() const
+{
+    switch (mergeMethod)
+    {
+    case ReplaceAll:
+        return &CellularGrid::evolve_packed_rows<Type, ReplaceAll>;
+    case ReplaceWorstInNeighborhood:
+        return &CellularGrid::evolve_packed_rows<Type, ReplaceWorstInNeighborhood>;
+    case ReplaceOneParent:
+        return &CellularGrid::evolve_packed_rows<Type, ReplaceOneParent>;
+    default:
+        assert(false && "Wrong merge method.");
+        return nullptr;
+    }
+}
 
-    for (uint row = rowFrom; row < rowTo; row++)
+CellularGrid::RowsKernel CellularGrid::select_packed_kernel() const
+{
+    switch (neighborhoodMethod)
     {
-        for (uint col = 0; col < colCount; col++)
-        {
-            neighborhood = get_neighborhood(row, col);
-            parents = select_parents(neighborhood);
-            offspring = reproduction(col, row, parents, dis012(gen));
+    case L5:
+        return select_packed_kernel<L5>();
+    case L9:
+        return select_packed_kernel<L9>();
+    case C9:
+        return select_packed_kernel<C9>();
+    case C13:
+        return select_packed_kernel<C13>();
+    default:
+        assert(false && "Wrong method");
+        return nullptr;
+    }
+}
 
-            if (mergeMethod == ReplaceWorstInNeighborhood)
-            {
-                offspring.cellToReplaceLocation = get_worst_cell(neighborhood).cellLocation;
-            }
-            else if (mergeMethod == ReplaceOneParent)
-            {
-                random = dis01(gen);
-                offspring.cellToReplaceLocation = (random == 0) ? parents.first.cellLocation : parents.second.cellLocation;
-            }
+// Kernel of the population layout.
+CellularGrid::RowsKernel CellularGrid::select_rows_kernel() const
+{
+    if (uses_planes())
+        return select_planar_kernel();
+    if (uses_packed_cells())
+        return select_packed_kernel();
+    return select_cell_kernel();
+}
 
-            result.push_back(offspring);
-        }
-    }
+void CellularGrid::synchronous_evolution_step()
+{
+    RowsKernel kernel = select_rows_kernel();
+    FitnessStatistics offspringStatistics = (this->*kernel)(0, rowCount, 0, colCount);
+
+    merge_offspring(offspringStatistics);
 }
 
-void CellularGrid::multithreaded_evolution_step(const int threadCount)
+void CellularGrid::multithreaded_evolution_step()
 {
-    std::vector<std::vector<Cell>> workersResults;
-    workersResults.reserve(threadCount);
-    {
-        std::vector<std::thread> workers;
+    // Every worker evolves its own band of rows directly into the shared offspring buffer.
+    std::vector<FitnessStatistics> workersStatistics(workerPool->size());
+    RowsKernel kernel = select_rows_kernel();
 
-        workers.reserve(threadCount);
+    workerPool->run([&](const int workerId, const int workerCount) {
+        uint rowFrom = (rowCount * workerId) / workerCount;
+        uint rowTo = (rowCount * (workerId + 1)) / workerCount;
+        workersStatistics[workerId] = (this->*kernel)(rowFrom, rowTo, 0, colCount);
+    });
 
-        int workerRowCount = rowCount / threadCount;
+    FitnessStatistics offspringStatistics;
+    for (const FitnessStatistics &workerStatistics : workersStatistics)
+        offspringStatistics.merge(workerStatistics);
+    merge_offspring(offspringStatistics);
+}
 
-        int workerRowFrom, workerRowTo;
-        for (int workerId = 0; workerId < threadCount; workerId++)
-        {
-            workerRowFrom = workerId * workerRowCount;
-            workerRowTo = (workerId == threadCount - 1) ? rowCount : workerRowFrom + workerRowCount;
+void CellularGrid::tiled_evolution_step()
+{
+    // Tiles are handed out by the work-stealing scheduler, so workers which finish early take over tiles of slower ones.
+    std::vector<FitnessStatistics> workersStatistics(workerPool->size());
+    RowsKernel kernel = select_rows_kernel();
 
-            workersResults.push_back(std::vector<Cell>());
+    uint tileRowCount = (rowCount + tileRows - 1) / tileRows;
+    uint tileColCount = (colCount + tileCols - 1) / tileCols;
+    if (!tileActivity.matches(tileRowCount, tileColCount))
+        tileActivity.reset(tileRowCount, tileColCount);
 
-            workers[workerId] = std::thread(&CellularGrid::worker_job, this, workerRowFrom, workerRowTo, std::ref(workersResults[workerId]));
+    // Surrounding tiles cover the neighborhoods of tile cells only if no tile is thinner than the stencil radius.
+    uint radius = neighborhood_radius(neighborhoodMethod);
+    uint lastTileRows = rowCount - ((tileRowCount - 1) * tileRows);
+    uint lastTileCols = colCount - ((tileColCount - 1) * tileCols);
+    bool trackActivity = (lastTileRows >= radius) && (lastTileCols >= radius);
+
+    // Tiles evolved in the last generation may have converged or may have been disturbed by their neighbors.
+    if (trackActivity)
+    {
+        workerPool->run([&](const int workerId, const int workerCount) {
+            for (uint tileIndex = workerId; tileIndex < tileRowCount * tileColCount; tileIndex += workerCount)
+            {
+                if (!tileActivity.stale[tileIndex])
+                    continue;
+
+                Tile tile;
+                tile.index = tileIndex;
+                tile.rowFrom = (tileIndex / tileColCount) * tileRows;
+                tile.colFrom = (tileIndex % tileColCount) * tileCols;
+                tile.rowTo = std::min(tile.rowFrom + tileRows, rowCount);
+                tile.colTo = std::min(tile.colFrom + tileCols, colCount);
+                tileActivity.optimal[tileIndex] = is_tile_optimal(tile);
+                tileActivity.stale[tileIndex] = 0;
+            }
+        });
+    }
+
+    tileScheduler.reset(rowCount, colCount, tileRows, tileCols, workerPool->size());
+    workerPool->run([&](const int workerId, const int) {
+        FitnessStatistics workerStatistics;
+        Tile tile;
+        while (tileScheduler.next(workerId, tile))
+        {
+            if (trackActivity && tileActivity.can_skip(tile.index))
+            {
+                if (!tileActivity.skipped[tile.index])
+                    fill_optimal_offspring(tile);
+                tileActivity.skipped[tile.index] = 1;
+                workerStatistics.add_optimal((uint64_t)(tile.rowTo - tile.rowFrom) * (tile.colTo - tile.colFrom));
+                continue;
+            }
+
+            workerStatistics.merge((this->*kernel)(tile.rowFrom, tile.rowTo, tile.colFrom, tile.colTo));
+            tileActivity.skipped[tile.index] = 0;
+            tileActivity.stale[tile.index] = 1;
         }
+        workersStatistics[workerId] = workerStatistics;
+    });
 
-        std::vector<Cell> newPopulation;
-        newPopulation.reserve(rowCount * colCount);
+    FitnessStatistics offspringStatistics;
+    for (const FitnessStatistics &workerStatistics : workersStatistics)
+        offspringStatistics.merge(workerStatistics);
+    merge_offspring(offspringStatistics);
+}
 
-        int offset = 0;
-        for (int workerId = 0; workerId < threadCount; workerId++)
+bool CellularGrid::is_tile_optimal(const Tile &tile) const
+{
+    for (uint row = tile.rowFrom; row < tile.rowTo; row++)
+    {
+        for (uint col = tile.colFrom; col < tile.colTo; col++)
         {
-            workers[workerId].join();
-            //printf("Thread %i reportedly completed.\n", workerId);
-            newPopulation.insert((newPopulation.begin() + offset), workersResults[workerId].begin(), workersResults[workerId].end());
-            offset += workersResults[workerId].size();
+            ushort fitness;
+            if (uses_planes())
+                fitness = currentPlanes.fitness[currentPlanes.index(row, col)];
+            else if (uses_packed_cells())
+                fitness = currentPackedCells[(row * colCount) + col].fitness();
+            else
+                fitness = currentPopulation[(row * colCount) + col].fitness;
+            if (fitness != MAX_FITNESS)
+                return false;
         }
+    }
+    return true;
+}
 
-        //std::lock_guard<std::mutex> lock(currentPopulationMutex);
-        currentPopulation = replace(rowCount, colCount, currentPopulation, newPopulation, mergeMethod);
+// Offspring of a skipped tile are maximal and replace only their own cell, which doesn't change anything.
+// They stay valid while the tile keeps being skipped, with ReplaceAll both buffers then hold the optimal tile.
+void CellularGrid::fill_optimal_offspring(const Tile &tile)
+{
+    for (uint row = tile.rowFrom; row < tile.rowTo; row++)
+    {
+        for (uint col = tile.colFrom; col < tile.colTo; col++)
+        {
+            if (uses_planes())
+            {
+                uint index = offspringPlanes.index(row, col);
+                offspringPlanes.set(index, UCHAR_MAX_AS_INT, UCHAR_MAX_AS_INT, UCHAR_MAX_AS_INT);
+                if (!replaceTargets.empty())
+                    replaceTargets[index] = index;
+            }
+            else if (uses_packed_cells())
+            {
+                uint index = (row * colCount) + col;
+                offspringPackedCells[index] = PackedCell(UCHAR_MAX_AS_INT, UCHAR_MAX_AS_INT, UCHAR_MAX_AS_INT);
+                if (!replaceTargets.empty())
+                    replaceTargets[index] = index;
+            }
+            else
+            {
+                Cell &offspring = offspringPopulation[(row * colCount) + col];
+                offspring = Cell(Point(col, row), UCHAR_MAX_AS_INT, UCHAR_MAX_AS_INT, UCHAR_MAX_AS_INT);
+                offspring.cellToReplaceLocation = Point(col, row);
+            }
+        }
     }
 }
 
+void CellularGrid::merge_offspring(const FitnessStatistics &offspringStatistics)
+{
+    PhaseTimer timer(phaseTimers, ReplacementPhase);
+    if (uses_planes())
+        replace(currentPlanes, offspringPlanes, replaceTargets, replacementSlots, statistics, offspringStatistics, mergeMethod);
+    else if (uses_packed_cells())
+        replace(currentPackedCells, offspringPackedCells, replaceTargets, replacementSlots, statistics, offspringStatistics, mergeMethod);
+    else
+        replace(rowCount, colCount, currentPopulation, offspringPopulation, replacementSlots, statistics, offspringStatistics, mergeMethod);
+}
+
 void print_point(const Point &p)
 {
     printf("Cell: at [%i;%i]\n", p.x, p.y);
 }
-void print_neighborhood(const std::vector<Cell> &neigh)
+void print_neighborhood(const Neighborhood &neigh)
 {
-    for (const Cell &n : neigh)
+    for (int i = 0; i < neigh.size; i++)
     {
-        print_point(n.cellLocation);
+        printf("Cell: at index %u with fitness %u\n", neigh.index[i], neigh.fitness[i]);
     }
 }
 
@@ -424,40 +1141,119 @@ void CellularGrid::openmp_evolution_step(const int threadCount)
 {
     omp_set_num_threads(threadCount);
 
-    std::vector<Cell> newPopulation;
-    newPopulation.resize(rowCount * colCount);
+    RowsKernel kernel = select_rows_kernel();
+
+    FitnessStatistics offspringStatistics;
+#pragma omp parallel for reduction(merge_statistics : offspringStatistics)
+    for (uint row = 0; row < rowCount; row++)
+    {
+        offspringStatistics.merge((this->*kernel)(row, row + 1, 0, colCount));
+    }
+
+    merge_offspring(offspringStatistics);
+}
 
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<int> dis012(0, 2); // Both ranges are inclusive.
-    std::uniform_int_distribution<int> dis01(0, 1);  // Both ranges are inclusive.
-    int random;
+void CellularGrid::planar_evolution_step(const int threadCount)
+{
+    omp_set_num_threads(threadCount);
 
-#pragma omp parallel for
+    RowsKernel kernel = select_planar_kernel();
+
+    FitnessStatistics offspringStatistics;
+#pragma omp parallel for reduction(merge_statistics : offspringStatistics)
     for (uint row = 0; row < rowCount; row++)
     {
-        for (uint col = 0; col < colCount; col++)
-        {
-            std::vector<Cell> neighborhood = get_neighborhood(row, col);
-            std::pair<Cell, Cell> parents = select_parents(neighborhood);
-            Cell offspring = reproduction(col, row, parents, dis012(gen));
+        offspringStatistics.merge((this->*kernel)(row, row + 1, 0, colCount));
+    }
 
-            if (mergeMethod == ReplaceWorstInNeighborhood)
-            {
-                offspring.cellToReplaceLocation = get_worst_cell(neighborhood).cellLocation;
-            }
-            else if (mergeMethod == ReplaceOneParent)
-            {
-                random = dis01(gen);
-                offspring.cellToReplaceLocation = (random == 0) ? parents.first.cellLocation : parents.second.cellLocation;
-            }
+    merge_offspring(offspringStatistics);
+}
 
-#pragma omp critical
+void CellularGrid::asynchronous_evolution_step(const int threadCount)
+{
+    SweepKernel kernel = select_sweep_kernel();
+
+    switch (updatePolicy)
+    {
+    case LineSweep:
+    {
+        (this->*kernel)(nullptr, 0, rowCount);
+        break;
+    }
+    case FixedRandomSweep:
+    {
+        (this->*kernel)(sweepOrder.data(), 0, sweepOrder.size());
+        break;
+    }
+    case ColoredBandSweep:
+    {
+        // Rows are split into bands at least two stencil radii high and bands of one color are swept in parallel.
+        // Same colored bands are separated by another band, so their neighborhoods never overlap.
+        // Odd band count on the toroidal grid needs a third color for the last band.
+        uint bandHeight = 2 * neighborhood_radius(neighborhoodMethod);
+        uint bandCount = std::max(1u, rowCount / bandHeight);
+        uint colorCount = (bandCount % 2 == 1 && bandCount > 1) ? 3 : 2;
+
+        omp_set_num_threads(threadCount);
+        for (uint color = 0; color < colorCount; color++)
+        {
+#pragma omp parallel for schedule(dynamic)
+            for (uint band = 0; band < bandCount; band++)
             {
-                newPopulation[(row * colCount) + col] = offspring;
+                uint bandColor = (colorCount == 3 && band == bandCount - 1) ? 2 : (band % 2);
+                if (bandColor != color)
+                    continue;
+
+                uint rowTo = (band == bandCount - 1) ? rowCount : ((band + 1) * bandHeight);
+                (this->*kernel)(nullptr, band * bandHeight, rowTo);
             }
         }
+        break;
     }
+    case ColoredCellSweep:
+    {
+        // Cells of one color class never read or write the same cell, so the class is split among threads freely
+        // and the result doesn't depend on the thread count.
+        omp_set_num_threads(threadCount);
+        for (uint color = 0; color < sweepColoring.colorCount; color++)
+        {
+            uint classFrom = sweepColoring.classStarts[color];
+            uint classTo = sweepColoring.classStarts[color + 1];
 
-    currentPopulation = replace(rowCount, colCount, currentPopulation, newPopulation, mergeMethod);
+#pragma omp parallel for schedule(dynamic)
+            for (uint chunkFrom = classFrom; chunkFrom < classTo; chunkFrom += COLORED_SWEEP_CHUNK)
+                (this->*kernel)(sweepColoring.cells.data(), chunkFrom, std::min(chunkFrom + COLORED_SWEEP_CHUNK, classTo));
+        }
+        break;
+    }
+    default:
+        assert(false && "Wrong update policy.");
+    }
+
+    PhaseTimer timer(phaseTimers, ScoringPhase);
+    statistics = compute_statistics();
 }
+
+void CellularGrid::temporal_blocking_step(const uint generationCount, const int threadCount)
+{
+    // Every tile advances generationCount generations of the ReplaceAll model from the current population,
+    // tiles recompute the overlapping margins instead of exchanging them.
+    omp_set_num_threads(threadCount);
+
+    TemporalBlockKernel kernel = select_temporal_block_kernel();
+    uint tileRowCount = (rowCount + tileRows - 1) / tileRows;
+    uint tileColCount = (colCount + tileCols - 1) / tileCols;
+
+    FitnessStatistics offspringStatistics;
+#pragma omp parallel for schedule(dynamic) reduction(merge_statistics : offspringStatistics)
+    for (uint tile = 0; tile < tileRowCount * tileColCount; tile++)
+    {
+        uint rowFrom = (tile / tileColCount) * tileRows;
+        uint colFrom = (tile % tileColCount) * tileCols;
+        offspringStatistics.merge((this->*kernel)(rowFrom, std::min(rowFrom + tileRows, rowCount),
+                                                  colFrom, std::min(colFrom + tileCols, colCount), generationCount));
+    }
+
+    currentGeneration += generationCount - 1;
+    merge_offspring(offspringStatistics);
+}
\ No newline at end of file
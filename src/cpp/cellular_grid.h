@@ -5,8 +5,16 @@
 #include <string>
 #include "operators.h"
 #include "stopwatch.h"
+#include "phase_timers.h"
+#include "worker_pool.h"
+#include "tile_scheduler.h"
+#include "coloring.h"
+#include "snapshot_writer.h"
+#include "frame_stream.h"
+#include "checkpoint.h"
 #include <thread>
 #include <mutex>
+#include <memory>
 
 class CellularGrid
 {
@@ -14,28 +22,117 @@ private:
   uint rowCount;
   uint colCount;
 
+  PopulationLayout populationLayout;
+  UpdatePolicy updatePolicy;
   std::vector<Cell> currentPopulation;
+  std::vector<Cell> offspringPopulation;
+  PlanarPopulation currentPlanes;
+  PlanarPopulation offspringPlanes;
+  PackedPopulation currentPackedCells;
+  PackedPopulation offspringPackedCells;
+  // Cells replaced by offspring of the planar and packed layouts.
+  std::vector<uint> replaceTargets;
+  ReplacementSlots replacementSlots;
+  // Visiting order of cells of the fixed random sweep.
+  std::vector<uint> sweepOrder;
+  // Color classes of the colored cell sweep.
+  GridColoring sweepColoring;
+  std::unique_ptr<WorkerPool> workerPool;
+  TileScheduler tileScheduler;
+  TileActivity tileActivity;
+  uint tileRows;
+  uint tileCols;
+  uint temporalBlockDepth;
+  SnapshotFormat snapshotFormat;
+  std::string checkpointFilename;
+  uint checkpointInterval;
+  PhaseTimers phaseTimers;
   std::mutex currentPopulationMutex;
 
+  uint64_t seed;
+  uint currentGeneration;
+  // Fitness statistics of the current population, collected by the evolution step.
+  FitnessStatistics statistics;
+
   NeighborhoodType neighborhoodMethod;
   PopulationMergeType mergeMethod;
 
+  // Kernels evolve cells of rows [rowFrom, rowTo) and columns [colFrom, colTo) and return fitness statistics of the offspring they created.
+  typedef FitnessStatistics (CellularGrid::*RowsKernel)(const uint rowFrom, const uint rowTo, const uint colFrom, const uint colTo);
+  typedef FitnessStatistics (CellularGrid::*TemporalBlockKernel)(const uint rowFrom, const uint rowTo, const uint colFrom, const uint colTo, const uint generationCount);
+  // Sweep kernels update cells in place, either rows [from, to) in line order or cells order[from, to) when order is given.
+  typedef void (CellularGrid::*SweepKernel)(const uint *order, const uint from, const uint to);
+
   Cell &at(uint row, uint col);
+  Cell get_cell(uint row, uint col) const;
+  bool uses_planes() const;
+  bool uses_packed_cells() const;
+  Point location_of(uint index) const;
+  void set_cell(uint row, uint col, const uchar r, const uchar g, const uchar b);
+  void prepare_population(const NeighborhoodType neighborhoodType, const PopulationMergeType mergeMethod, const PopulationLayout layout, const uint64_t seed,
+                          const UpdatePolicy updatePolicy);
+  void capture_snapshot(Snapshot &snapshot, const uint generation, const bool bw) const;
+  FitnessStatistics compute_statistics() const;
   void synchronous_evolution_step();
-  void multithreaded_evolution_step(const int threadCount);
+  void multithreaded_evolution_step();
+  void tiled_evolution_step();
+  void merge_offspring(const FitnessStatistics &offspringStatistics);
+  bool is_tile_optimal(const Tile &tile) const;
+  void fill_optimal_offspring(const Tile &tile);
+  void asynchronous_evolution_step(const int threadCount);
+  bool uses_temporal_blocking() const;
+  void temporal_blocking_step(const uint generationCount, const int threadCount);
   void openmp_evolution_step(const int threadCount);
-  std::vector<Cell> get_neighborhood(const uint row, const uint col);
-  void worker_job(int rowFrom, int rowTo, std::vector<Cell> &result);
+  void planar_evolution_step(const int threadCount);
+  template <NeighborhoodType Type, PopulationMergeType Merge>
+  FitnessStatistics evolve_cell_rows(const uint rowFrom, const uint rowTo, const uint colFrom, const uint colTo);
+  template <NeighborhoodType Type, PopulationMergeType Merge>
+  FitnessStatistics evolve_planar_rows(const uint rowFrom, const uint rowTo, const uint colFrom, const uint colTo);
+  template <NeighborhoodType Type, PopulationMergeType Merge>
+  FitnessStatistics evolve_packed_rows(const uint rowFrom, const uint rowTo, const uint colFrom, const uint colTo);
+  template <NeighborhoodType Type>
+  FitnessStatistics evolve_temporal_block(const uint rowFrom, const uint rowTo, const uint colFrom, const uint colTo, const uint generationCount);
+  TemporalBlockKernel select_temporal_block_kernel() const;
+  template <NeighborhoodType Type, PopulationMergeType Merge>
+  void sweep(const uint *order, const uint from, const uint to);
+  template <NeighborhoodType Type, PopulationMergeType Merge, typename Population>
+  void update_in_place(Population &population, const uint row, const uint colFrom, const uint colTo);
+  template <NeighborhoodType Type>
+  RowsKernel select_cell_kernel() const;
+  RowsKernel select_cell_kernel() const;
+  template <NeighborhoodType Type>
+  RowsKernel select_planar_kernel() const;
+  RowsKernel select_planar_kernel() const;
+  template <NeighborhoodType Type>
+  RowsKernel select_packed_kernel() const;
+  RowsKernel select_packed_kernel() const;
+  RowsKernel select_rows_kernel() const;
+  template <NeighborhoodType Type>
+  SweepKernel select_sweep_kernel() const;
+  SweepKernel select_sweep_kernel() const;
 
 public:
   CellularGrid(const uint dimension);
   CellularGrid(const uint width, const uint height);
 
-  void initialize(const NeighborhoodType neighborhoodType, const PopulationMergeType mergeMethod, const InitializationType initType);
+  void initialize(const NeighborhoodType neighborhoodType, const PopulationMergeType mergeMethod, const InitializationType initType, const PopulationLayout layout = ArrayOfCells, const uint64_t seed = random_seed(),
+                  const UpdatePolicy updatePolicy = SynchronousUpdate);
+  uint64_t get_seed() const;
+  void set_tile_size(const uint tileRows, const uint tileCols);
+  void set_temporal_blocking(const uint generationsPerBlock);
+  void set_snapshot_format(const SnapshotFormat format);
+  void set_checkpointing(const std::string &filename, const uint generationInterval);
+  void save_checkpoint(const std::string &filename) const;
+  void restore_checkpoint(const std::string &filename);
+  uint get_current_generation() const;
+  void set_phase_timing(const bool enabled);
+  const PhaseTimers &get_phase_timers() const;
   double get_score_of_generation() const;
+  const FitnessStatistics &get_statistics_of_generation() const;
 
   void dump_current_population_to_image(const std::string &folder, uint generation = 0, bool bw = false);
-  void evolve(const int maxGenerationCount, const bool multiThreaded, const int threadCount = 12, const bool saveImages = false, const std::string &folder = "");
+  void evolve(const int maxGenerationCount, const bool multiThreaded, const int threadCount = 12, const bool saveImages = false, const std::string &folder = "",
+              const ThreadingModel threadingModel = OpenMPThreads);
 
   ~CellularGrid();
 };
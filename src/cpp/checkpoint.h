@@ -0,0 +1,296 @@
+#pragma once
+#include "cell.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CHECKPOINT_MMAP 1
+#endif
+
+// Checkpoint file is a header page followed by R, G, B (uchar) and fitness (ushort) planes of the grid in row-major order.
+// Every plane starts at a page boundary, so a mapped checkpoint is used directly and its pages are faulted in as they are read.
+// Layout doesn't depend on the population layout of the grid, a checkpoint can be restored into any of them.
+
+constexpr uint32_t CHECKPOINT_MAGIC = 0x4B434743;
+constexpr uint32_t CHECKPOINT_VERSION = 1;
+constexpr uint64_t CHECKPOINT_ALIGNMENT = 4096;
+
+struct CheckpointHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t rowCount;
+    uint32_t colCount;
+    uint32_t neighborhoodType;
+    uint32_t mergeType;
+    uint32_t populationLayout;
+    uint32_t updatePolicy;
+    // Last completed generation, together with the seed it is the whole state of the counter-based generator.
+    uint32_t generation;
+    uint32_t reserved;
+    uint64_t seed;
+
+    // Fitness statistics of the population, so that restart doesn't have to scan it.
+    uint64_t count;
+    uint64_t sum;
+    uint64_t sumOfSquares;
+    uint64_t optimalCount;
+    uint32_t minFitness;
+    uint32_t maxFitness;
+
+    uint64_t redOffset;
+    uint64_t greenOffset;
+    uint64_t blueOffset;
+    uint64_t fitnessOffset;
+    uint64_t fileSize;
+};
+
+static_assert(sizeof(CheckpointHeader) <= CHECKPOINT_ALIGNMENT, "Checkpoint header has to fit into the header page.");
+
+inline uint64_t align_checkpoint_offset(const uint64_t offset)
+{
+    return ((offset + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT) * CHECKPOINT_ALIGNMENT;
+}
+
+// Fills plane offsets and file size of the header from its grid dimensions.
+inline void layout_checkpoint(CheckpointHeader &header)
+{
+    uint64_t cellCount = (uint64_t)header.rowCount * header.colCount;
+    header.redOffset = CHECKPOINT_ALIGNMENT;
+    header.greenOffset = align_checkpoint_offset(header.redOffset + cellCount);
+    header.blueOffset = align_checkpoint_offset(header.greenOffset + cellCount);
+    header.fitnessOffset = align_checkpoint_offset(header.blueOffset + cellCount);
+    header.fileSize = align_checkpoint_offset(header.fitnessOffset + (cellCount * sizeof(ushort)));
+}
+
+// Header of a complete checkpoint file of fileSize bytes has the layout of its dimensions.
+inline bool is_valid_checkpoint(const CheckpointHeader &header, const uint64_t fileSize)
+{
+    if ((header.magic != CHECKPOINT_MAGIC) || (header.version != CHECKPOINT_VERSION))
+        return false;
+
+    CheckpointHeader expected = header;
+    layout_checkpoint(expected);
+    return (memcmp(&expected, &header, sizeof(CheckpointHeader)) == 0) && (fileSize >= header.fileSize);
+}
+
+// Checkpoints of large grids don't fit the offset range of fseek() everywhere.
+inline bool seek_checkpoint(FILE *file, const uint64_t offset)
+{
+#if defined(CHECKPOINT_MMAP)
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#elif defined(_WIN32)
+    return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+    return fseek(file, (long)offset, SEEK_SET) == 0;
+#endif
+}
+
+// Writes the checkpoint next to the target file and renames it over the target in commit(),
+// so a run interrupted while writing still has its previous checkpoint.
+class CheckpointWriter
+{
+public:
+    CheckpointWriter(const std::string &filename, const CheckpointHeader &header)
+    {
+        this->filename = filename;
+        this->header = header;
+        temporaryFilename = filename + ".tmp";
+        offset = 0;
+        end = 0;
+        file = fopen(temporaryFilename.c_str(), "wb");
+        if (file == nullptr)
+            throw std::runtime_error("Unable to open file " + temporaryFilename);
+
+        write(&this->header, sizeof(CheckpointHeader));
+    }
+
+    ~CheckpointWriter()
+    {
+        if (file != nullptr)
+        {
+            fclose(file);
+            remove(temporaryFilename.c_str());
+        }
+    }
+
+    CheckpointWriter(const CheckpointWriter &) = delete;
+    CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+    // Planes have to be written in file order, every plane starts at its aligned offset.
+    void begin_plane(const uint64_t planeOffset)
+    {
+        assert(planeOffset >= offset);
+        pad_to(planeOffset);
+    }
+
+    void write(const void *bytes, const size_t size)
+    {
+        if (fwrite(bytes, 1, size, file) != size)
+            throw std::runtime_error("Checkpoint write failed.");
+        offset += size;
+        end = std::max(end, offset);
+    }
+
+    // Writes at any position of the file, for writers which produce the planes band by band.
+    // Parts which are never written are zeros.
+    void write_at(const uint64_t position, const void *bytes, const size_t size)
+    {
+        if ((position != offset) && !seek_checkpoint(file, position))
+            throw std::runtime_error("Checkpoint write failed.");
+        offset = position;
+        write(bytes, size);
+    }
+
+    // Header is known only after the planes of a streamed checkpoint are written.
+    void update_header(const CheckpointHeader &header)
+    {
+        assert(header.fileSize == this->header.fileSize);
+        this->header = header;
+        write_at(0, &this->header, sizeof(CheckpointHeader));
+    }
+
+    void commit()
+    {
+        if ((offset != end) && !seek_checkpoint(file, end))
+            throw std::runtime_error("Checkpoint write failed.");
+        offset = end;
+        pad_to(header.fileSize);
+        bool written = fflush(file) == 0;
+#ifdef CHECKPOINT_MMAP
+        written = written && (fsync(fileno(file)) == 0);
+#endif
+        written = (fclose(file) == 0) && written;
+        file = nullptr;
+        if (!written || (rename(temporaryFilename.c_str(), filename.c_str()) != 0))
+        {
+            remove(temporaryFilename.c_str());
+            throw std::runtime_error("Checkpoint " + filename + " wasn't written.");
+        }
+    }
+
+private:
+    FILE *file;
+    std::string filename;
+    std::string temporaryFilename;
+    CheckpointHeader header;
+    uint64_t offset;
+    // End of the written part of the file.
+    uint64_t end;
+
+    void pad_to(const uint64_t target)
+    {
+        static const uchar zeros[CHECKPOINT_ALIGNMENT] = {0};
+        while (offset < target)
+            write(zeros, (size_t)std::min<uint64_t>(target - offset, CHECKPOINT_ALIGNMENT));
+    }
+};
+
+// View of a checkpoint file. The file is memory mapped where mmap is available, otherwise it is read at once.
+// Mapping is private, writes to it are copied on write and never reach the file.
+class MappedCheckpoint
+{
+public:
+    MappedCheckpoint(const std::string &filename)
+    {
+        data = nullptr;
+        size = 0;
+#ifdef CHECKPOINT_MMAP
+        int descriptor = open(filename.c_str(), O_RDONLY);
+        if (descriptor < 0)
+            throw std::runtime_error("Unable to open file " + filename);
+        struct stat fileStatus;
+        if (fstat(descriptor, &fileStatus) == 0)
+            size = (size_t)fileStatus.st_size;
+        void *mapping = (size >= sizeof(CheckpointHeader)) ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0) : MAP_FAILED;
+        close(descriptor);
+        if (mapping == MAP_FAILED)
+            throw std::runtime_error(filename + " is not a checkpoint.");
+        data = (const uchar *)mapping;
+#else
+        FILE *file = fopen(filename.c_str(), "rb");
+        if (file == nullptr)
+            throw std::runtime_error("Unable to open file " + filename);
+        uchar buffer[1 << 16];
+        size_t readCount;
+        while ((readCount = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            contents.insert(contents.end(), buffer, buffer + readCount);
+        fclose(file);
+        data = contents.data();
+        size = contents.size();
+#endif
+
+        if ((size < sizeof(CheckpointHeader)) || (header().magic != CHECKPOINT_MAGIC) || (header().version != CHECKPOINT_VERSION))
+        {
+            unmap();
+            throw std::runtime_error(filename + " is not a checkpoint.");
+        }
+
+        if (!is_valid_checkpoint(header(), size))
+        {
+            unmap();
+            throw std::runtime_error(filename + " is truncated or corrupted.");
+        }
+    }
+
+    ~MappedCheckpoint()
+    {
+        unmap();
+    }
+
+    MappedCheckpoint(const MappedCheckpoint &) = delete;
+    MappedCheckpoint &operator=(const MappedCheckpoint &) = delete;
+
+    const CheckpointHeader &header() const
+    {
+        return *(const CheckpointHeader *)data;
+    }
+
+    const uchar *red() const
+    {
+        return data + header().redOffset;
+    }
+
+    const uchar *green() const
+    {
+        return data + header().greenOffset;
+    }
+
+    const uchar *blue() const
+    {
+        return data + header().blueOffset;
+    }
+
+    const ushort *fitness() const
+    {
+        return (const ushort *)(data + header().fitnessOffset);
+    }
+
+    // Plane at offset, which may be written in place of a copy of it.
+    uchar *writable_plane(const uint64_t offset)
+    {
+        return (uchar *)data + offset;
+    }
+
+private:
+    const uchar *data;
+    size_t size;
+    std::vector<uchar> contents;
+
+    void unmap()
+    {
+#ifdef CHECKPOINT_MMAP
+        if (data != nullptr)
+            munmap((void *)data, size);
+#endif
+        data = nullptr;
+    }
+};
\ No newline at end of file
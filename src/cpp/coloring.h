@@ -0,0 +1,144 @@
+#pragma once
+#include "neighborhood.h"
+#include "enums.h"
+#include <vector>
+#include <algorithm>
+
+// Number of cells of a color class given to one thread at a time.
+constexpr uint COLORED_SWEEP_CHUNK = 1024;
+
+// Partition of the toroidal grid into color classes whose cells can be updated in place concurrently.
+// Cells of one class are stored contiguously in row-major order, class c spans cells[classStarts[c]] to cells[classStarts[c + 1]].
+struct GridColoring
+{
+    uint colorCount;
+    std::vector<uint> cells;
+    std::vector<uint> classStarts;
+
+    GridColoring()
+    {
+        colorCount = 0;
+    }
+
+    size_t class_size(const uint color) const
+    {
+        return classStarts[color + 1] - classStarts[color];
+    }
+};
+
+// Offsets between two cells which must not be updated at the same time.
+// Update of a cell reads its neighborhood and writes either the cell itself (ReplaceAll) or any cell of the neighborhood,
+// so conflicts are offsets of the stencil, resp. differences of two stencil offsets.
+template <NeighborhoodType Type>
+std::vector<std::pair<int, int>> conflict_offsets(const PopulationMergeType mergeMethod)
+{
+    std::vector<std::pair<int, int>> offsets;
+    auto add = [&](const int dRow, const int dCol) {
+        if ((dRow == 0 && dCol == 0) || std::find(offsets.begin(), offsets.end(), std::make_pair(dRow, dCol)) != offsets.end())
+            return;
+        offsets.push_back(std::make_pair(dRow, dCol));
+    };
+
+    for (int i = 0; i < Stencil<Type>::size; i++)
+    {
+        if (mergeMethod == ReplaceAll)
+        {
+            add(Stencil<Type>::rowOffsets[i], Stencil<Type>::colOffsets[i]);
+            add(-Stencil<Type>::rowOffsets[i], -Stencil<Type>::colOffsets[i]);
+            continue;
+        }
+        for (int j = 0; j < Stencil<Type>::size; j++)
+            add(Stencil<Type>::rowOffsets[i] - Stencil<Type>::rowOffsets[j], Stencil<Type>::colOffsets[i] - Stencil<Type>::colOffsets[j]);
+    }
+    return offsets;
+}
+
+// Coloring color(row, col) = (a * row + b * col) mod k with the smallest k, which is valid on the torus.
+// Falls back to greedy coloring of the conflict graph when the grid dimensions admit no such lattice coloring.
+template <NeighborhoodType Type>
+GridColoring color_grid(const PopulationMergeType mergeMethod, const uint rowCount, const uint colCount)
+{
+    std::vector<std::pair<int, int>> offsets = conflict_offsets<Type>(mergeMethod);
+    uint maxColorCount = offsets.size() + 1;
+    std::vector<uint> colors(rowCount * colCount);
+
+    uint colorCount = 0;
+    for (uint k = 2; (k <= maxColorCount) && (colorCount == 0); k++)
+    {
+        for (uint a = 0; (a < k) && (colorCount == 0); a++)
+        {
+            for (uint b = 0; (b < k) && (colorCount == 0); b++)
+            {
+                if (((a * rowCount) % k != 0) || ((b * colCount) % k != 0))
+                    continue;
+
+                bool valid = true;
+                for (const std::pair<int, int> &offset : offsets)
+                    valid &= positive_mod(((int)a * offset.first) + ((int)b * offset.second), (int)k) != 0;
+                if (!valid)
+                    continue;
+
+                colorCount = k;
+                for (uint row = 0; row < rowCount; row++)
+                    for (uint col = 0; col < colCount; col++)
+                        colors[(row * colCount) + col] = ((a * row) + (b * col)) % k;
+            }
+        }
+    }
+
+    if (colorCount == 0)
+    {
+        std::vector<bool> used(maxColorCount);
+        for (uint row = 0; row < rowCount; row++)
+        {
+            for (uint col = 0; col < colCount; col++)
+            {
+                std::fill(used.begin(), used.end(), false);
+                for (const std::pair<int, int> &offset : offsets)
+                {
+                    uint neighbor = (positive_mod((int)row + offset.first, (int)rowCount) * colCount) + positive_mod((int)col + offset.second, (int)colCount);
+                    if (neighbor < (row * colCount) + col)
+                        used[colors[neighbor]] = true;
+                }
+
+                uint color = 0;
+                while (used[color])
+                    color++;
+                colors[(row * colCount) + col] = color;
+                colorCount = std::max(colorCount, color + 1);
+            }
+        }
+    }
+
+    GridColoring coloring;
+    coloring.colorCount = colorCount;
+    coloring.classStarts.assign(colorCount + 1, 0);
+    for (uint color : colors)
+        coloring.classStarts[color + 1]++;
+    for (uint color = 0; color < colorCount; color++)
+        coloring.classStarts[color + 1] += coloring.classStarts[color];
+
+    std::vector<uint> position(coloring.classStarts.begin(), coloring.classStarts.end() - 1);
+    coloring.cells.resize(colors.size());
+    for (uint index = 0; index < colors.size(); index++)
+        coloring.cells[position[colors[index]]++] = index;
+    return coloring;
+}
+
+inline GridColoring color_grid(const NeighborhoodType neighborhoodType, const PopulationMergeType mergeMethod, const uint rowCount, const uint colCount)
+{
+    switch (neighborhoodType)
+    {
+    case L5:
+        return color_grid<L5>(mergeMethod, rowCount, colCount);
+    case L9:
+        return color_grid<L9>(mergeMethod, rowCount, colCount);
+    case C9:
+        return color_grid<C9>(mergeMethod, rowCount, colCount);
+    case C13:
+        return color_grid<C13>(mergeMethod, rowCount, colCount);
+    default:
+        assert(false && "Wrong method");
+        return GridColoring();
+    }
+}
\ No newline at end of file
@@ -19,4 +19,30 @@ enum InitializationType
     RandomWithDiscrimination,
     FitBorders,
     FitCorner
+};
+enum PopulationLayout
+{
+    ArrayOfCells,
+    StructureOfArrays,
+    PaddedStructureOfArrays,
+    PackedCells
+};
+enum ThreadingModel
+{
+    OpenMPThreads,
+    WorkerPoolThreads,
+    WorkStealingTiles
+};
+enum UpdatePolicy
+{
+    SynchronousUpdate,
+    LineSweep,
+    FixedRandomSweep,
+    ColoredBandSweep,
+    ColoredCellSweep
+};
+enum SnapshotFormat
+{
+    BitmapSnapshots,
+    FrameStreamSnapshots
 };
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+#include "cell.h"
+#include <stdint.h>
+
+constexpr ushort MAX_FITNESS = (ushort)MAX_FITNESS_VALUE;
+
+// Integer moments of population fitness, collected while the population is written.
+// Partial statistics of rows or threads are combined with merge(), integer sums make the result independent of the order.
+struct FitnessStatistics
+{
+    uint64_t count;
+    uint64_t sum;
+    uint64_t sumOfSquares;
+    uint64_t optimalCount;
+    ushort min;
+    ushort max;
+
+    FitnessStatistics()
+    {
+        count = 0;
+        sum = 0;
+        sumOfSquares = 0;
+        optimalCount = 0;
+        min = MAX_FITNESS;
+        max = 0;
+    }
+
+    inline void add(const ushort fitness)
+    {
+        count++;
+        sum += fitness;
+        sumOfSquares += (uint64_t)fitness * fitness;
+        optimalCount += (fitness == MAX_FITNESS);
+        min = (fitness < min) ? fitness : min;
+        max = (fitness > max) ? fitness : max;
+    }
+
+    // Adds count cells of maximal fitness.
+    void add_optimal(const uint64_t cellCount)
+    {
+        if (cellCount == 0)
+            return;
+        count += cellCount;
+        sum += cellCount * MAX_FITNESS;
+        sumOfSquares += cellCount * MAX_FITNESS * MAX_FITNESS;
+        optimalCount += cellCount;
+        min = (MAX_FITNESS < min) ? MAX_FITNESS : min;
+        max = MAX_FITNESS;
+    }
+
+    // Vectorized add() of a contiguous run of fitness values.
+    void add_row(const ushort *fitness, const uint length)
+    {
+        uint rowSum = 0;
+        uint64_t rowSumOfSquares = 0;
+        uint rowOptimalCount = 0;
+        ushort rowMin = min;
+        ushort rowMax = max;
+
+#pragma omp simd reduction(+ : rowSum, rowSumOfSquares, rowOptimalCount) reduction(min : rowMin) reduction(max : rowMax)
+        for (uint i = 0; i < length; i++)
+        {
+            ushort value = fitness[i];
+            rowSum += value;
+            rowSumOfSquares += (uint)value * value;
+            rowOptimalCount += (value == MAX_FITNESS);
+            rowMin = (value < rowMin) ? value : rowMin;
+            rowMax = (value > rowMax) ? value : rowMax;
+        }
+
+        count += length;
+        sum += rowSum;
+        sumOfSquares += rowSumOfSquares;
+        optimalCount += rowOptimalCount;
+        min = rowMin;
+        max = rowMax;
+    }
+
+    void merge(const FitnessStatistics &other)
+    {
+        count += other.count;
+        sum += other.sum;
+        sumOfSquares += other.sumOfSquares;
+        optimalCount += other.optimalCount;
+        min = (other.min < min) ? other.min : min;
+        max = (other.max > max) ? other.max : max;
+    }
+
+    double mean() const
+    {
+        return (count == 0) ? 0.0 : ((double)sum / (double)count);
+    }
+
+    double variance() const
+    {
+        if (count == 0)
+            return 0.0;
+        double average = mean();
+        return ((double)sumOfSquares / (double)count) - (average * average);
+    }
+};
+
+#pragma omp declare reduction(merge_statistics : FitnessStatistics : omp_out.merge(omp_in)) initializer(omp_priv = FitnessStatistics())
\ No newline at end of file
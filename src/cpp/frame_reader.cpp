@@ -0,0 +1,58 @@
+#include "frame_stream.h"
+#include "image.cpp"
+#include <stdlib.h>
+#include <algorithm>
+
+// Lists frames of a frame stream, or converts them to generation_N.bmp files.
+// Without generations every frame is converted.
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <frame stream> [<output folder> [generation...]]\n", argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        FrameStreamReader reader(argv[1]);
+        const FrameStreamHeader &header = reader.stream_header();
+
+        if (argc == 2)
+        {
+            printf("Grid %ux%u, %u channel(s), %zu frame(s)\n", header.width, header.height, header.channelCount, reader.frame_count());
+            for (size_t frame = 0; frame < reader.frame_count(); frame++)
+            {
+                const FrameHeader &frameHeader = reader.frame_header(frame);
+                printf("Generation %u: %llu bytes%s\n", frameHeader.generation, (unsigned long long)frameHeader.encodedSize, frameHeader.keyframe ? " (keyframe)" : "");
+            }
+            return 0;
+        }
+
+        std::string folder = argv[2];
+        std::vector<uint> generations;
+        for (int i = 3; i < argc; i++)
+            generations.push_back((uint)strtoul(argv[i], nullptr, 10));
+
+        Snapshot snapshot;
+        size_t convertedCount = 0;
+        for (size_t frame = 0; frame < reader.frame_count(); frame++)
+        {
+            uint generation = reader.frame_header(frame).generation;
+            if (!generations.empty() && std::find(generations.begin(), generations.end(), generation) == generations.end())
+                continue;
+
+            reader.read(frame, snapshot);
+            std::string filename = folder + "/generation_" + std::to_string(generation) + ".bmp";
+            save_bmp(filename, snapshot.pixels.data(), snapshot.width, snapshot.height, snapshot.channelCount);
+            convertedCount++;
+        }
+        printf("Converted %zu frame(s).\n", convertedCount);
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,347 @@
+#pragma once
+#include "snapshot_writer.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Single append-only file holding snapshots of a whole run.
+// File starts with FrameStreamHeader, every frame is a FrameHeader followed by its encoded planes.
+// Planes are XORed with the previous frame, keyframes with zeros, and the result is stored as pairs of
+// (zero run, literal run) lengths followed by the literal bytes, so unchanged parts of the grid cost almost nothing.
+// Keyframes let the reader start decoding in the middle of the stream.
+
+constexpr uint32_t FRAME_STREAM_MAGIC = 0x46414743;
+constexpr uint32_t FRAME_STREAM_VERSION = 1;
+constexpr uint32_t DEFAULT_KEYFRAME_INTERVAL = 64;
+// Shorter runs of unchanged bytes are kept inside the literal run, their lengths would cost more than the bytes.
+constexpr size_t MIN_ZERO_RUN = 8;
+
+struct FrameStreamHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channelCount;
+    uint32_t keyframeInterval;
+};
+
+struct FrameHeader
+{
+    uint32_t generation;
+    uint32_t keyframe;
+    uint64_t encodedSize;
+};
+
+inline void put_varint(std::vector<uchar> &encoded, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        encoded.push_back((uchar)(value | 0x80));
+        value >>= 7;
+    }
+    encoded.push_back((uchar)value);
+}
+
+inline uint64_t get_varint(const uchar *&data, const uchar *end)
+{
+    uint64_t value = 0;
+    for (uint shift = 0; shift < 64; shift += 7)
+    {
+        if (data == end)
+            throw std::runtime_error("Truncated frame.");
+        uchar byte = *data++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+    throw std::runtime_error("Corrupted frame.");
+}
+
+// Encodes data against previous, nullptr previous stands for zeros.
+inline void encode_frame(const uchar *data, const uchar *previous, const size_t size, std::vector<uchar> &encoded)
+{
+    auto delta = [&](const size_t i) -> uchar { return (previous != nullptr) ? (uchar)(data[i] ^ previous[i]) : data[i]; };
+
+    encoded.clear();
+    size_t i = 0;
+    while (i < size)
+    {
+        size_t zeroFrom = i;
+        while ((i < size) && (delta(i) == 0))
+            i++;
+
+        size_t literalFrom = i;
+        while (i < size)
+        {
+            size_t zeroTo = i;
+            while ((zeroTo < size) && (zeroTo - i < MIN_ZERO_RUN) && (delta(zeroTo) == 0))
+                zeroTo++;
+            if ((zeroTo > i) && ((zeroTo - i >= MIN_ZERO_RUN) || (zeroTo == size)))
+                break;
+            i = (zeroTo > i) ? zeroTo : (i + 1);
+        }
+
+        put_varint(encoded, literalFrom - zeroFrom);
+        put_varint(encoded, i - literalFrom);
+        for (size_t k = literalFrom; k < i; k++)
+            encoded.push_back(delta(k));
+    }
+}
+
+// Decodes frame into data, which holds the previous frame, or anything for a keyframe.
+inline void decode_frame(const uchar *encoded, const size_t encodedSize, const bool keyframe, uchar *data, const size_t size)
+{
+    const uchar *end = encoded + encodedSize;
+    size_t i = 0;
+    while (encoded != end)
+    {
+        uint64_t zeroRun = get_varint(encoded, end);
+        uint64_t literalRun = get_varint(encoded, end);
+        if ((zeroRun + literalRun > size - i) || (literalRun > (uint64_t)(end - encoded)))
+            throw std::runtime_error("Corrupted frame.");
+
+        for (size_t k = 0; k < zeroRun; k++, i++)
+            data[i] = keyframe ? 0 : data[i];
+        for (size_t k = 0; k < literalRun; k++, i++)
+            data[i] = keyframe ? encoded[k] : (uchar)(data[i] ^ encoded[k]);
+        encoded += literalRun;
+    }
+    if (i != size)
+        throw std::runtime_error("Truncated frame.");
+}
+
+// Reads the stream header and indexes complete frames, a frame cut off by an interrupted run ends the stream.
+// Offsets point at the encoded planes of the frames.
+inline void read_frame_index(FILE *file, const std::string &filename, FrameStreamHeader &header, std::vector<FrameHeader> &frames, std::vector<long> &offsets)
+{
+    fseek(file, 0, SEEK_SET);
+    if ((fread(&header, sizeof(header), 1, file) != 1) || (header.magic != FRAME_STREAM_MAGIC))
+        throw std::runtime_error(filename + " is not a frame stream.");
+    if (header.version != FRAME_STREAM_VERSION)
+        throw std::runtime_error(filename + " has unsupported frame stream version.");
+
+    frames.clear();
+    offsets.clear();
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    long offset = sizeof(header);
+    FrameHeader frame;
+    while (fseek(file, offset, SEEK_SET) == 0 && fread(&frame, sizeof(frame), 1, file) == 1)
+    {
+        long payloadOffset = offset + (long)sizeof(frame);
+        if ((uint64_t)(fileSize - payloadOffset) < frame.encodedSize)
+            break;
+        frames.push_back(frame);
+        offsets.push_back(payloadOffset);
+        offset = payloadOffset + (long)frame.encodedSize;
+    }
+}
+
+// Appends snapshots to the stream, the file header is written with the first frame.
+// Every frame is flushed, so a stream of an interrupted run is readable up to its last complete frame.
+// Run restored at resumeGeneration continues the stream of the run it was restored from. Frames written
+// after that generation and a frame cut off by the interruption are dropped, and the first appended frame
+// is a keyframe, so the stream decodes across the restart. Without an existing stream a new one is started.
+class FrameStreamWriter
+{
+public:
+    FrameStreamWriter(const std::string &filename, const uint32_t keyframeInterval = DEFAULT_KEYFRAME_INTERVAL, const uint32_t resumeGeneration = 0)
+    {
+        assert(keyframeInterval > 0);
+        this->keyframeInterval = keyframeInterval;
+        frameCount = 0;
+        headerWritten = false;
+        file = (resumeGeneration > 0) ? open_resumed(filename, resumeGeneration) : nullptr;
+        if (file == nullptr)
+            file = fopen(filename.c_str(), "wb");
+        if (file == nullptr)
+            throw std::runtime_error("Unable to open file " + filename);
+    }
+
+    ~FrameStreamWriter()
+    {
+        fclose(file);
+    }
+
+    FrameStreamWriter(const FrameStreamWriter &) = delete;
+    FrameStreamWriter &operator=(const FrameStreamWriter &) = delete;
+
+    void write(const Snapshot &snapshot)
+    {
+        if (!headerWritten)
+        {
+            headerWritten = true;
+            header.magic = FRAME_STREAM_MAGIC;
+            header.version = FRAME_STREAM_VERSION;
+            header.width = snapshot.width;
+            header.height = snapshot.height;
+            header.channelCount = snapshot.channelCount;
+            header.keyframeInterval = keyframeInterval;
+            write_bytes(&header, sizeof(header));
+        }
+        else if ((snapshot.width != header.width) || (snapshot.height != header.height) || (snapshot.channelCount != header.channelCount))
+        {
+            throw std::runtime_error("Snapshot doesn't match the frame stream dimensions.");
+        }
+
+        FrameHeader frame;
+        frame.generation = snapshot.generation;
+        frame.keyframe = previous.empty() || ((frameCount % keyframeInterval) == 0);
+        encode_frame(snapshot.pixels.data(), frame.keyframe ? nullptr : previous.data(), snapshot.pixels.size(), encoded);
+        frame.encodedSize = encoded.size();
+
+        write_bytes(&frame, sizeof(frame));
+        write_bytes(encoded.data(), encoded.size());
+        fflush(file);
+
+        previous = snapshot.pixels;
+        frameCount++;
+    }
+
+private:
+    FILE *file;
+    FrameStreamHeader header;
+    uint32_t keyframeInterval;
+    uint32_t frameCount;
+    bool headerWritten;
+    std::vector<uchar> previous;
+    std::vector<uchar> encoded;
+
+    // Opens the existing stream positioned after its last frame up to resumeGeneration, nullptr when there is no stream yet.
+    FILE *open_resumed(const std::string &filename, const uint32_t resumeGeneration)
+    {
+        FILE *existing = fopen(filename.c_str(), "r+b");
+        if (existing == nullptr)
+            return nullptr;
+
+        // Header is written with the first frame, an empty file is a run interrupted before it.
+        fseek(existing, 0, SEEK_END);
+        if (ftell(existing) == 0)
+        {
+            fclose(existing);
+            return nullptr;
+        }
+
+        std::vector<FrameHeader> frames;
+        std::vector<long> offsets;
+        try
+        {
+            read_frame_index(existing, filename, header, frames, offsets);
+        }
+        catch (...)
+        {
+            fclose(existing);
+            throw;
+        }
+
+        size_t keptCount = 0;
+        while ((keptCount < frames.size()) && (frames[keptCount].generation <= resumeGeneration))
+            keptCount++;
+        long end = (keptCount > 0) ? (offsets[keptCount - 1] + (long)frames[keptCount - 1].encodedSize) : (long)sizeof(header);
+
+        std::error_code error;
+        std::filesystem::resize_file(filename, end, error);
+        if (error || (fseek(existing, end, SEEK_SET) != 0))
+        {
+            fclose(existing);
+            throw std::runtime_error("Unable to resume frame stream " + filename);
+        }
+
+        // Snapshots are checked against the dimensions of the existing header.
+        headerWritten = true;
+        if (header.keyframeInterval > 0)
+            keyframeInterval = header.keyframeInterval;
+        frameCount = (uint32_t)keptCount;
+        return existing;
+    }
+
+    void write_bytes(const void *bytes, const size_t size)
+    {
+        if (fwrite(bytes, 1, size, file) != size)
+            throw std::runtime_error("Frame stream write failed.");
+    }
+};
+
+// Random access to frames of a stream. Frames are decoded from the closest preceding keyframe,
+// consecutive reads continue from the last decoded frame.
+class FrameStreamReader
+{
+public:
+    FrameStreamReader(const std::string &filename)
+    {
+        lastDecoded = -1;
+        file = fopen(filename.c_str(), "rb");
+        if (file == nullptr)
+            throw std::runtime_error("Unable to open file " + filename);
+
+        try
+        {
+            read_frame_index(file, filename, header, frames, offsets);
+        }
+        catch (...)
+        {
+            fclose(file);
+            throw;
+        }
+    }
+
+    ~FrameStreamReader()
+    {
+        fclose(file);
+    }
+
+    FrameStreamReader(const FrameStreamReader &) = delete;
+    FrameStreamReader &operator=(const FrameStreamReader &) = delete;
+
+    const FrameStreamHeader &stream_header() const
+    {
+        return header;
+    }
+
+    size_t frame_count() const
+    {
+        return frames.size();
+    }
+
+    const FrameHeader &frame_header(const size_t frame) const
+    {
+        return frames[frame];
+    }
+
+    void read(const size_t frame, Snapshot &snapshot)
+    {
+        assert(frame < frames.size());
+        size_t from = frame;
+        while (!frames[from].keyframe)
+            from--;
+        if ((lastDecoded >= (long)from) && (lastDecoded <= (long)frame))
+            from = lastDecoded + 1;
+
+        current.resize(header.width, header.height, header.channelCount);
+        for (size_t i = from; i <= frame; i++)
+        {
+            encoded.resize(frames[i].encodedSize);
+            fseek(file, offsets[i], SEEK_SET);
+            if (fread(encoded.data(), 1, encoded.size(), file) != encoded.size())
+                throw std::runtime_error("Frame stream read failed.");
+            decode_frame(encoded.data(), encoded.size(), frames[i].keyframe, current.pixels.data(), current.pixels.size());
+            lastDecoded = i;
+        }
+
+        snapshot = current;
+        snapshot.generation = frames[frame].generation;
+    }
+
+private:
+    FILE *file;
+    FrameStreamHeader header;
+    std::vector<FrameHeader> frames;
+    std::vector<long> offsets;
+    Snapshot current;
+    long lastDecoded;
+    std::vector<uchar> encoded;
+};
\ No newline at end of file
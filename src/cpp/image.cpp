@@ -1,5 +1,9 @@
 #define cimg_display 0
 #include "CImg.h"
+#include <stdio.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 typedef unsigned char uchar;
 
@@ -64,4 +68,71 @@ cimg_library::CImg<uchar> create_color_image(const uint width, const uint height
     cimg_library::CImg<uchar> image(width, height, 1, 3);
     image.fill(0);
     return image;
+}
+
+inline void put_uint32(uchar *bytes, const uint value)
+{
+    bytes[0] = (uchar)value;
+    bytes[1] = (uchar)(value >> 8);
+    bytes[2] = (uchar)(value >> 16);
+    bytes[3] = (uchar)(value >> 24);
+}
+
+// Writes the same 24-bit BMP as CImg::save_bmp(), but a whole row at a time instead of every byte by itself.
+// Pixels are channelCount (1 or 3) planes of width * height bytes, single channel is written as gray.
+void save_bmp(const std::string &filename, const uchar *pixels, const uint width, const uint height, const uint channelCount)
+{
+    const uint align = (4 - ((3 * width) % 4)) % 4;
+    const uint rowSize = (3 * width) + align;
+    const uint dataSize = rowSize * height;
+
+    uchar header[54] = {0};
+    header[0x00] = 'B';
+    header[0x01] = 'M';
+    put_uint32(header + 0x02, 54 + dataSize);
+    header[0x0A] = 0x36;
+    header[0x0E] = 0x28;
+    put_uint32(header + 0x12, width);
+    put_uint32(header + 0x16, height);
+    header[0x1A] = 1;
+    header[0x1C] = 24;
+    put_uint32(header + 0x22, dataSize);
+    header[0x27] = 0x1;
+    header[0x2B] = 0x1;
+
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (file == nullptr)
+        throw std::runtime_error("Unable to open file " + filename);
+
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header))
+    {
+        fclose(file);
+        throw std::runtime_error("Image " + filename + " wasn't written.");
+    }
+
+    // Rows are stored bottom-up with BGR pixels.
+    const size_t planeSize = (size_t)width * height;
+    const uchar *red = pixels;
+    const uchar *green = (channelCount == 3) ? (pixels + planeSize) : pixels;
+    const uchar *blue = (channelCount == 3) ? (pixels + (2 * planeSize)) : pixels;
+    std::vector<uchar> row(rowSize, 0);
+    for (uint y = height; y > 0; y--)
+    {
+        size_t rowStart = (size_t)(y - 1) * width;
+        for (uint x = 0; x < width; x++)
+        {
+            row[(3 * x)] = blue[rowStart + x];
+            row[(3 * x) + 1] = green[rowStart + x];
+            row[(3 * x) + 2] = red[rowStart + x];
+        }
+        if (fwrite(row.data(), 1, rowSize, file) != rowSize)
+        {
+            fclose(file);
+            throw std::runtime_error("Image " + filename + " wasn't written.");
+        }
+    }
+
+    // Buffered rows may fail only when they are flushed by fclose().
+    if (fclose(file) != 0)
+        throw std::runtime_error("Image " + filename + " wasn't written.");
 }
\ No newline at end of file
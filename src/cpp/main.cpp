@@ -1,4 +1,4 @@
-#include "cellular_grid.h"
+#include "out_of_core_grid.h"
 
 int main(int, char **)
 {
@@ -6,10 +6,28 @@ int main(int, char **)
     const bool Parallel = true;
     const bool saveImages = false;
     const uint ThreadCount = 12;
+    const PopulationLayout Layout = PopulationLayout::ArrayOfCells;
+    const ThreadingModel Threading = ThreadingModel::OpenMPThreads;
+    const UpdatePolicy Update = UpdatePolicy::SynchronousUpdate;
+    const SnapshotFormat Snapshots = SnapshotFormat::BitmapSnapshots;
+    const bool OutOfCore = false;
+    const bool PhaseTiming = false;
+
+    if (OutOfCore)
+    {
+        // Population lives in the file, only bands of rows are held in memory.
+        OutOfCoreGrid::create("population.ck", 500, 500, NeighborhoodType::L5, PopulationMergeType::ReplaceAll, InitializationType::RandomWithDiscrimination, random_seed());
+        OutOfCoreGrid grid("population.ck");
+        grid.set_phase_timing(PhaseTiming);
+        grid.evolve(MaxIterationCount, ThreadCount);
+        return 0;
+    }
 
     CellularGrid cg(500);
-    cg.initialize(NeighborhoodType::L5, PopulationMergeType::ReplaceAll, InitializationType::RandomWithDiscrimination);
-    cg.evolve(MaxIterationCount, Parallel, ThreadCount, saveImages, "bw");
+    cg.initialize(NeighborhoodType::L5, PopulationMergeType::ReplaceAll, InitializationType::RandomWithDiscrimination, Layout, random_seed(), Update);
+    cg.set_snapshot_format(Snapshots);
+    cg.set_phase_timing(PhaseTiming);
+    cg.evolve(MaxIterationCount, Parallel, ThreadCount, saveImages, "bw", Threading);
 
     return 0;
-}
+}
\ No newline at end of file
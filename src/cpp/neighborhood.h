@@ -0,0 +1,186 @@
+#pragma once
+#include "cell.h"
+#include "planar_population.h"
+#include "packed_population.h"
+#include "enums.h"
+#include <algorithm>
+#include <vector>
+
+constexpr int MAX_NEIGHBORHOOD_SIZE = 13;
+
+// Fixed-capacity neighborhood living on the stack.
+// Stores population indices and fitness values of neighbors instead of copied cells.
+struct Neighborhood
+{
+    int size;
+    uint index[MAX_NEIGHBORHOOD_SIZE];
+    ushort fitness[MAX_NEIGHBORHOOD_SIZE];
+
+    Neighborhood()
+    {
+        size = 0;
+    }
+
+    inline void add(const uint cellIndex, const ushort cellFitness)
+    {
+        assert(size < MAX_NEIGHBORHOOD_SIZE);
+        index[size] = cellIndex;
+        fitness[size] = cellFitness;
+        size++;
+    }
+};
+
+inline int neighborhood_size(const NeighborhoodType type)
+{
+    switch (type)
+    {
+    case L5:
+        return 5;
+    case L9:
+    case C9:
+        return 9;
+    case C13:
+        return 13;
+    default:
+        assert(false && "Wrong method");
+        return 0;
+    }
+}
+
+inline int neighborhood_radius(const NeighborhoodType type)
+{
+    switch (type)
+    {
+    case L5:
+    case C9:
+        return 1;
+    case L9:
+    case C13:
+        return 2;
+    default:
+        assert(false && "Wrong method");
+        return 0;
+    }
+}
+
+inline ushort fitness_of(const std::vector<Cell> &population, const uint index)
+{
+    return population[index].fitness;
+}
+
+inline ushort fitness_of(const PlanarPopulation &population, const uint index)
+{
+    return population.fitness[index];
+}
+
+inline ushort fitness_of(const PackedPopulation &population, const uint index)
+{
+    return population[index].fitness();
+}
+
+// Modulo for any negative x, stencils of grids thinner than their radius wrap more than once.
+inline uint positive_mod(const int x, const int modulus)
+{
+    return (uint)(((x % modulus) + modulus) % modulus);
+}
+
+// Stencil offsets of every neighborhood type, in the order in which neighbors are gathered.
+// Center is the entry of the cell itself.
+template <NeighborhoodType Type>
+struct Stencil;
+
+template <>
+struct Stencil<L5>
+{
+    static constexpr int size = 5;
+    static constexpr int center = 0;
+    static constexpr int radius = 1;
+    static constexpr int rowOffsets[size] = {0, 0, -1, 0, 1};
+    static constexpr int colOffsets[size] = {0, -1, 0, 1, 0};
+};
+
+template <>
+struct Stencil<L9>
+{
+    static constexpr int size = 9;
+    static constexpr int center = 0;
+    static constexpr int radius = 2;
+    static constexpr int rowOffsets[size] = {0, 0, 0, -1, -2, 0, 0, 1, 2};
+    static constexpr int colOffsets[size] = {0, -1, -2, 0, 0, 1, 2, 0, 0};
+};
+
+template <>
+struct Stencil<C9>
+{
+    static constexpr int size = 9;
+    static constexpr int center = 4;
+    static constexpr int radius = 1;
+    static constexpr int rowOffsets[size] = {-1, -1, -1, 0, 0, 0, 1, 1, 1};
+    static constexpr int colOffsets[size] = {-1, 0, 1, -1, 0, 1, -1, 0, 1};
+};
+
+template <>
+struct Stencil<C13>
+{
+    static constexpr int size = 13;
+    static constexpr int center = 4;
+    static constexpr int radius = 2;
+    static constexpr int rowOffsets[size] = {-1, -1, -1, 0, 0, 0, 1, 1, 1, 0, -2, 0, 2};
+    static constexpr int colOffsets[size] = {-1, 0, 1, -1, 0, 1, -1, 0, 1, -2, 0, 2, 0};
+};
+
+// Gather for cells whose stencil can't cross the grid border, no wrap-around is needed.
+template <NeighborhoodType Type, typename Population>
+inline Neighborhood gather_interior(const Population &population, const uint index, const int stride)
+{
+    Neighborhood neighborhood;
+    for (int i = 0; i < Stencil<Type>::size; i++)
+    {
+        uint neighborIndex = index + (Stencil<Type>::rowOffsets[i] * stride) + Stencil<Type>::colOffsets[i];
+        neighborhood.add(neighborIndex, fitness_of(population, neighborIndex));
+    }
+    return neighborhood;
+}
+
+// Gather for cells of the border ring, neighbors are wrapped around the toroidal grid.
+template <NeighborhoodType Type, typename Population>
+inline Neighborhood gather_wrapped(const Population &population, const int row, const int col, const int rowCount, const int colCount)
+{
+    Neighborhood neighborhood;
+    for (int i = 0; i < Stencil<Type>::size; i++)
+    {
+        uint neighborIndex = (positive_mod(row + Stencil<Type>::rowOffsets[i], rowCount) * colCount) + positive_mod(col + Stencil<Type>::colOffsets[i], colCount);
+        neighborhood.add(neighborIndex, fitness_of(population, neighborIndex));
+    }
+    return neighborhood;
+}
+
+// Calls cellFunction(col, neighborhood) for cells [colFrom, colTo) of the row.
+// Border ring cells take the wrapping gather, interior cells the plain offset gather.
+template <NeighborhoodType Type, typename Population, typename CellFunction>
+inline void for_each_neighborhood_in_row(const Population &population, const uint row, const uint colFrom, const uint colTo, const uint rowCount, const uint colCount, CellFunction cellFunction)
+{
+    constexpr uint radius = Stencil<Type>::radius;
+    bool borderRow = (row < radius) || (row + radius >= rowCount);
+    uint interiorFrom = borderRow ? colTo : std::min(std::max(radius, colFrom), colTo);
+    uint interiorTo = borderRow ? colTo : std::max(interiorFrom, std::min((colCount > radius) ? (colCount - radius) : 0, colTo));
+
+    for (uint col = colFrom; col < interiorFrom; col++)
+        cellFunction(col, gather_wrapped<Type>(population, row, col, rowCount, colCount));
+
+    uint rowStart = row * colCount;
+    for (uint col = interiorFrom; col < interiorTo; col++)
+        cellFunction(col, gather_interior<Type>(population, rowStart + col, colCount));
+
+    for (uint col = interiorTo; col < colTo; col++)
+        cellFunction(col, gather_wrapped<Type>(population, row, col, rowCount, colCount));
+}
+
+// Calls cellFunction(col, neighborhood) for cells [colFrom, colTo) of a padded row.
+// Halo of the population covers the stencil radius, so every cell takes the plain offset gather.
+template <NeighborhoodType Type, typename Population, typename CellFunction>
+inline void for_each_neighborhood_in_padded_row(const Population &population, const uint rowStart, const uint colFrom, const uint colTo, const int stride, CellFunction cellFunction)
+{
+    for (uint col = colFrom; col < colTo; col++)
+        cellFunction(col, gather_interior<Type>(population, rowStart + col, stride));
+}
\ No newline at end of file
@@ -1,59 +1,171 @@
 #include "cell.h"
+#include "planar_population.h"
+#include "neighborhood.h"
+#include "random.h"
+#include "replacement.h"
+#include "fitness_statistics.h"
+#include "selection.h"
+#include "simd_reproduction.h"
 #include "enums.h"
 #include <vector>
 #include <random>
 #include <omp.h>
 
-inline int mod(const int x, const int mod)
+uint get_worst_cell_index(const Neighborhood &neighborhood)
 {
-    return ((x >= 0) ? (x % mod) : (x + mod));
-}
-
-Cell get_worst_cell(const std::vector<Cell> &neighborhood)
-{
-    Cell worst = Cell(Point(-1, -1));
-    worst.R = 255;
-    worst.G = 255;
-    worst.B = 255;
+    int worst = -1;
+    ushort worstFitness = (ushort)MAX_FITNESS_VALUE;
 
-    for (size_t i = 0; i < neighborhood.size(); i++)
+    for (int i = 0; i < neighborhood.size; i++)
     {
-        if (neighborhood[i].get_fitness() <= worst.get_fitness())
+        if (neighborhood.fitness[i] <= worstFitness)
         {
-            worst = neighborhood[i];
+            worst = i;
+            worstFitness = neighborhood.fitness[i];
         }
     }
-    assert(worst.cellLocation.x != -1 && worst.cellLocation.y != -1);
-    return worst;
+    assert(worst != -1);
+    return neighborhood.index[worst];
 }
 
-std::vector<Cell> replace(int rowCount, int colCount, std::vector<Cell> &currentPopulation, std::vector<Cell> &newPopulation, PopulationMergeType method)
+// statistics receive fitness statistics of the merged population, offspringStatistics are those of the whole newPopulation.
+// Replacement visits every cell anyway, so the statistics are collected in the same pass.
+void replace(int rowCount, int colCount, std::vector<Cell> &currentPopulation, std::vector<Cell> &newPopulation, ReplacementSlots &slots,
+             FitnessStatistics &statistics, const FitnessStatistics &offspringStatistics, PopulationMergeType method)
 {
     switch (method)
     {
     case ReplaceAll:
     {
-        return newPopulation;
+        currentPopulation.swap(newPopulation);
+        statistics = offspringStatistics;
+        return;
     }
     case ReplaceWorstInNeighborhood:
     case ReplaceOneParent:
     {
+        // When more offspring target the same cell, the last one in row-major order wins.
+
 #pragma omp parallel for
         for (int row = 0; row < rowCount; row++)
         {
             for (int col = 0; col < colCount; col++)
             {
-                Cell offspring = newPopulation[(row * colCount) + col];
+                int index = (row * colCount) + col;
+                const Cell &offspring = newPopulation[index];
                 Point toReplaceLocation = offspring.cellToReplaceLocation;
-                offspring.cellLocation = toReplaceLocation;
+                slots.offer((toReplaceLocation.y * colCount) + toReplaceLocation.x, index, offspring.R, offspring.G, offspring.B);
+            }
+        }
 
-#pragma omp critical
-                {
-                    currentPopulation[(toReplaceLocation.y * colCount) + toReplaceLocation.x] = offspring;
-                }
+        uchar r, g, b;
+        FitnessStatistics mergedStatistics;
+#pragma omp parallel for private(r, g, b) reduction(merge_statistics : mergedStatistics)
+        for (int row = 0; row < rowCount; row++)
+        {
+            for (int col = 0; col < colCount; col++)
+            {
+                int index = (row * colCount) + col;
+                if (slots.take(index, r, g, b))
+                    currentPopulation[index] = Cell(Point(col, row), r, g, b);
+                mergedStatistics.add(currentPopulation[index].fitness);
             }
         }
-        return currentPopulation;
+        statistics = mergedStatistics;
+        return;
+    }
+    default:
+    {
+        assert(false && "Wrong merge method.");
+    }
+    }
+}
+
+void replace(PlanarPopulation &currentPopulation, PlanarPopulation &newPopulation, const std::vector<uint> &replaceTargets, ReplacementSlots &slots,
+             FitnessStatistics &statistics, const FitnessStatistics &offspringStatistics, PopulationMergeType method)
+{
+    switch (method)
+    {
+    case ReplaceAll:
+    {
+        currentPopulation.swap(newPopulation);
+        statistics = offspringStatistics;
+        currentPopulation.refresh_halo();
+        return;
+    }
+    case ReplaceWorstInNeighborhood:
+    case ReplaceOneParent:
+    {
+        // Padded index order is row-major as well, so the same offspring wins as in the cell layout.
+
+#pragma omp parallel for
+        for (uint row = 0; row < newPopulation.rowCount; row++)
+        {
+            for (uint col = 0; col < newPopulation.colCount; col++)
+            {
+                uint index = newPopulation.index(row, col);
+                slots.offer(currentPopulation.wrap_index(replaceTargets[index]), index, newPopulation.R[index], newPopulation.G[index], newPopulation.B[index]);
+            }
+        }
+
+        uchar r, g, b;
+        FitnessStatistics mergedStatistics;
+#pragma omp parallel for private(r, g, b) reduction(merge_statistics : mergedStatistics)
+        for (uint row = 0; row < currentPopulation.rowCount; row++)
+        {
+            uint rowStart = currentPopulation.index(row, 0);
+            for (uint col = 0; col < currentPopulation.colCount; col++)
+            {
+                if (slots.take(rowStart + col, r, g, b))
+                    currentPopulation.set(rowStart + col, r, g, b);
+            }
+            mergedStatistics.add_row(&currentPopulation.fitness[rowStart], currentPopulation.colCount);
+        }
+        statistics = mergedStatistics;
+        currentPopulation.refresh_halo();
+        return;
+    }
+    default:
+    {
+        assert(false && "Wrong merge method.");
+    }
+    }
+}
+
+void replace(PackedPopulation &currentPopulation, PackedPopulation &newPopulation, const std::vector<uint> &replaceTargets, ReplacementSlots &slots,
+             FitnessStatistics &statistics, const FitnessStatistics &offspringStatistics, PopulationMergeType method)
+{
+    switch (method)
+    {
+    case ReplaceAll:
+    {
+        currentPopulation.swap(newPopulation);
+        statistics = offspringStatistics;
+        return;
+    }
+    case ReplaceWorstInNeighborhood:
+    case ReplaceOneParent:
+    {
+        int size = (int)currentPopulation.size();
+
+#pragma omp parallel for
+        for (int index = 0; index < size; index++)
+        {
+            const PackedCell &offspring = newPopulation[index];
+            slots.offer(replaceTargets[index], index, offspring.red(), offspring.green(), offspring.blue());
+        }
+
+        uchar r, g, b;
+        FitnessStatistics mergedStatistics;
+#pragma omp parallel for private(r, g, b) reduction(merge_statistics : mergedStatistics)
+        for (int index = 0; index < size; index++)
+        {
+            if (slots.take(index, r, g, b))
+                currentPopulation[index] = PackedCell(r, g, b);
+            mergedStatistics.add(currentPopulation[index].fitness());
+        }
+        statistics = mergedStatistics;
+        return;
     }
     default:
     {
@@ -62,7 +174,7 @@ std::vector<Cell> replace(int rowCount, int colCount, std::vector<Cell> &current
     }
 }
 
-std::vector<Cell> replace_row(int row, int colCount, std::vector<Cell> &currentPopulation, std::vector<Cell> &newPopulation, PopulationMergeType method)
+void replace_row(int row, int colCount, std::vector<Cell> &currentPopulation, std::vector<Cell> &newPopulation, PopulationMergeType method)
 {
     switch (method)
     {
@@ -74,7 +186,7 @@ std::vector<Cell> replace_row(int row, int colCount, std::vector<Cell> &currentP
             Cell offspring = newPopulation[index];
             currentPopulation[index] = offspring;
         }
-        return currentPopulation;
+        return;
     }
     case ReplaceWorstInNeighborhood:
     case ReplaceOneParent:
@@ -88,7 +200,7 @@ std::vector<Cell> replace_row(int row, int colCount, std::vector<Cell> &currentP
             currentPopulation[(replaceLocation.y * colCount) + replaceLocation.x] = offspring;
         }
 
-        return currentPopulation;
+        return;
     }
     default:
     {
@@ -104,60 +216,149 @@ inline uchar max(const uchar a, const uchar b)
 
 Cell reproduction(int x, int y, std::pair<Cell, Cell> parents, int randomValue)
 {
-    Cell offspring(Point(x, y));
     switch (randomValue)
     {
     case 0:
-    {
-        offspring.R = max(parents.first.R, parents.second.R);
-        offspring.G = max(parents.first.G, parents.second.G);
-        offspring.B = max(parents.first.B, parents.second.B);
-
-        return offspring;
+        return Cell(Point(x, y),
+                    max(parents.first.R, parents.second.R),
+                    max(parents.first.G, parents.second.G),
+                    max(parents.first.B, parents.second.B));
+    case 1:
+        return Cell(Point(x, y),
+                    max(parents.first.B, parents.second.B),
+                    max(parents.first.R, parents.second.R),
+                    max(parents.first.G, parents.second.G));
+    case 2:
+        return Cell(Point(x, y),
+                    max(parents.first.G, parents.second.G),
+                    max(parents.first.B, parents.second.B),
+                    max(parents.first.R, parents.second.R));
+    default:
+        assert(false && "Only random values allowed are 0, 1, and 2.");
+        return Cell(Point(x, y));
     }
+}
+
+PackedCell reproduction(const PackedCell first, const PackedCell second, int randomValue)
+{
+    switch (randomValue)
+    {
+    case 0:
+        return PackedCell(max(first.red(), second.red()),
+                          max(first.green(), second.green()),
+                          max(first.blue(), second.blue()));
     case 1:
+        return PackedCell(max(first.blue(), second.blue()),
+                          max(first.red(), second.red()),
+                          max(first.green(), second.green()));
+    case 2:
+        return PackedCell(max(first.green(), second.green()),
+                          max(first.blue(), second.blue()),
+                          max(first.red(), second.red()));
+    default:
+        assert(false && "Only random values allowed are 0, 1, and 2.");
+        return PackedCell();
+    }
+}
+
+// Genome of a cell of the initial population (generation 0).
+// Every cell draws from its own stream, cells outside of the fit region don't need to generate any random numbers.
+void initial_genome(const InitializationType initType, const uint64_t seed, const uint row, const uint col, const uint rowCount, const uint colCount,
+                    uchar &r, uchar &g, uchar &b)
+{
+    uint64_t cellIndex = ((uint64_t)row * colCount) + col;
+    switch (initType)
+    {
+    case RandomWithDiscrimination:
     {
-        offspring.R = max(parents.first.B, parents.second.B);
-        offspring.G = max(parents.first.R, parents.second.R);
-        offspring.B = max(parents.first.G, parents.second.G);
+        uchar discrimination = (uchar)((row * col) % UCHAR_MAX_AS_INT);
+        CounterRandom random(seed, 0, cellIndex);
+        r = (uchar)random_below(random, 256);
+        g = (uchar)random_below(random, 256);
+        b = (uchar)random_below(random, 256);
 
-        return offspring;
+        r = (r > discrimination) ? (uchar)(r - discrimination) : r;
+        g = (g > discrimination) ? (uchar)(g - discrimination) : g;
+        b = (b > discrimination) ? (uchar)(b - discrimination) : b;
+        return;
     }
-    case 2:
+    case FitBorders:
+    case FitCorner:
     {
-        offspring.R = max(parents.first.G, parents.second.G);
-        offspring.G = max(parents.first.B, parents.second.B);
-        offspring.B = max(parents.first.R, parents.second.R);
+        bool randomCell = false;
+        if (initType == FitBorders)
+        {
+            uint borderSize = rowCount / 15;
+            randomCell = (row < borderSize) || (col < borderSize) || (row > (rowCount - borderSize)) || (col > (colCount - borderSize));
+        }
+        else
+        {
+            uint borderSize = rowCount / 10;
+            randomCell = (row < borderSize) && (col < borderSize);
+        }
 
-        return offspring;
+        if (randomCell)
+        {
+            CounterRandom random(seed, 0, cellIndex);
+            r = (uchar)random_below(random, 256);
+            g = (uchar)random_below(random, 256);
+            b = (uchar)random_below(random, 256);
+        }
+        else
+        {
+            r = 1;
+            g = 1;
+            b = 1;
+        }
+        return;
     }
     default:
-        assert(false && "Only random values allowed are 0, 1, and 2.");
+        assert(false && "Wrong initialization type.");
+        r = 0;
+        g = 0;
+        b = 0;
+        return;
     }
 }
 
-std::pair<Cell, Cell> select_parents(const std::vector<Cell> &neighborhood)
+inline Cell genome_at(const std::vector<Cell> &population, const uint index)
 {
-    std::random_device randomDevice;
-    std::mt19937 randomGenerator(randomDevice());
+    return population[index];
+}
 
-    std::vector<float> weights;
-    weights.reserve(neighborhood.size());
+inline Cell genome_at(const PlanarPopulation &population, const uint index)
+{
+    return Cell(Point(), population.R[index], population.G[index], population.B[index]);
+}
 
-    for (size_t i = 0; i < neighborhood.size(); i++)
-    {
-        weights.push_back((neighborhood[i].get_fitness() / MAX_FITNESS_VALUE));
-    }
+inline Cell genome_at(const PackedPopulation &population, const uint index)
+{
+    return Cell(Point(), population[index].red(), population[index].green(), population[index].blue());
+}
 
-    std::discrete_distribution<int> discreteDistribution = std::discrete_distribution<int>(std::begin(weights), std::end(weights));
-    int indexA = discreteDistribution(randomGenerator);
-    int indexB = discreteDistribution(randomGenerator);
+// In-place replacement of asynchronous updates, the cell keeps its location.
+inline void store_genome(std::vector<Cell> &population, const uint index, const uchar r, const uchar g, const uchar b)
+{
+    population[index] = Cell(population[index].cellLocation, r, g, b);
+}
 
-    while (indexA == indexB)
-    {
-        indexB = discreteDistribution(randomGenerator);
-    }
+inline void store_genome(PlanarPopulation &population, const uint index, const uchar r, const uchar g, const uchar b)
+{
+    population.set_mirrored(index, r, g, b);
+}
+
+inline void store_genome(PackedPopulation &population, const uint index, const uchar r, const uchar g, const uchar b)
+{
+    population[index] = PackedCell(r, g, b);
+}
+
+template <typename Random>
+std::pair<uint, uint> select_parents(const Neighborhood &neighborhood, Random &random)
+{
+    uint32_t drawA = random();
+    uint32_t drawB = random();
 
-    auto result = std::make_pair(neighborhood[indexA], neighborhood[indexB]);
-    return result;
+    int slotA, slotB;
+    select_parent_slots(neighborhood.fitness, neighborhood.size, drawA, drawB, slotA, slotB);
+    return std::make_pair(neighborhood.index[slotA], neighborhood.index[slotB]);
 }
\ No newline at end of file
@@ -0,0 +1,533 @@
+#pragma once
+#include "cellular_grid.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Grid rows evolved at once, the band with its halo rows is the only part of the population held in memory.
+constexpr uint DEFAULT_BAND_ROWS = 256;
+constexpr uint NO_REPLACE_TARGET = 0xFFFFFFFF;
+
+// Band of grid rows loaded from the population store, surrounded by halo rows of the rows above and below it.
+// Halo rows wrap around the torus, columns have the padded halo, so neighborhoods are gathered without wrapping.
+struct PopulationBand
+{
+    uint gridRowFrom;
+    uint rowCount;
+    PlanarPopulation rows;
+    // Grid row of every loaded row.
+    std::vector<uint> gridRows;
+};
+
+// Synchronous evolution of grids larger than memory.
+// Population lives in a checkpoint file and every generation streams it band by band into the checkpoint of the next
+// generation, which then replaces it. Next band is read by a prefetch task while the current one evolves.
+// Offspring draw from the streams of their grid cells, so the result is the one of the in-memory engines,
+// a checkpoint written by CellularGrid::save_checkpoint() can be continued here and the other way around.
+// Store is a valid checkpoint after every generation, an interrupted run is continued by opening it again.
+class OutOfCoreGrid
+{
+public:
+    OutOfCoreGrid(const std::string &filename, const uint bandRows = DEFAULT_BAND_ROWS)
+    {
+        this->filename = filename;
+        FILE *file = fopen(filename.c_str(), "rb");
+        if (file == nullptr)
+            throw std::runtime_error("Unable to open file " + filename);
+
+        bool read = fread(&header, sizeof(CheckpointHeader), 1, file) == 1;
+        uint64_t fileSize = 0;
+        if (read && seek_end(file))
+            fileSize = file_position(file);
+        fclose(file);
+        if (!read || !is_valid_checkpoint(header, fileSize))
+            throw std::runtime_error(filename + " is not a checkpoint.");
+        if ((header.neighborhoodType > C13) || (header.mergeType > ReplaceOneParent))
+            throw std::runtime_error(filename + " has unknown configuration.");
+        if (header.updatePolicy != SynchronousUpdate)
+            throw std::runtime_error("Out-of-core evolution supports only the synchronous update.");
+        // Bands gather neighborhoods through the padded column halo only.
+        if (header.colCount < HALO_SIZE)
+            throw std::runtime_error("Out-of-core evolution needs at least " + std::to_string(HALO_SIZE) + " columns.");
+
+        rowCount = header.rowCount;
+        colCount = header.colCount;
+        neighborhoodMethod = (NeighborhoodType)header.neighborhoodType;
+        mergeMethod = (PopulationMergeType)header.mergeType;
+        statistics = load_statistics(header);
+
+        // Slot merges need offspring of the rows around the band, which in turn need halo rows of their own.
+        radius = (uint)neighborhood_radius(neighborhoodMethod);
+        offspringHaloRows = (mergeMethod == ReplaceAll) ? 0 : radius;
+        haloRows = radius + offspringHaloRows;
+        this->bandRows = std::max(1u, std::min(bandRows, rowCount));
+        assert((uint64_t)(this->bandRows + (2 * offspringHaloRows)) * colCount < NO_REPLACE_TARGET);
+    }
+
+    OutOfCoreGrid(const OutOfCoreGrid &) = delete;
+    OutOfCoreGrid &operator=(const OutOfCoreGrid &) = delete;
+
+    // Writes generation 0 of a new run band by band, the population is the one of CellularGrid::initialize().
+    static void create(const std::string &filename, const uint rowCount, const uint colCount, const NeighborhoodType neighborhoodType,
+                       const PopulationMergeType mergeMethod, const InitializationType initType, const uint64_t seed, const uint bandRows = DEFAULT_BAND_ROWS)
+    {
+        CheckpointHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = CHECKPOINT_MAGIC;
+        header.version = CHECKPOINT_VERSION;
+        header.rowCount = rowCount;
+        header.colCount = colCount;
+        header.neighborhoodType = neighborhoodType;
+        header.mergeType = mergeMethod;
+        header.populationLayout = PaddedStructureOfArrays;
+        header.updatePolicy = SynchronousUpdate;
+        header.seed = seed;
+        layout_checkpoint(header);
+
+        CheckpointWriter writer(filename, header);
+        PlanarPopulation band(std::max(1u, std::min(bandRows, rowCount)), colCount);
+        FitnessStatistics initialStatistics;
+        for (uint rowFrom = 0; rowFrom < rowCount; rowFrom += band.rowCount)
+        {
+            uint rows = std::min(band.rowCount, rowCount - rowFrom);
+            uchar r, g, b;
+#pragma omp parallel for private(r, g, b) reduction(merge_statistics : initialStatistics)
+            for (uint row = 0; row < rows; row++)
+            {
+                for (uint col = 0; col < colCount; col++)
+                {
+                    initial_genome(initType, seed, rowFrom + row, col, rowCount, colCount, r, g, b);
+                    band.set(band.index(row, col), r, g, b);
+                }
+                initialStatistics.add_row(&band.fitness[band.index(row, 0)], colCount);
+            }
+            write_rows(writer, header, band, rowFrom, rows);
+        }
+
+        store_statistics(header, initialStatistics);
+        writer.update_header(header);
+        writer.commit();
+    }
+
+    void evolve(const int maxGenerationCount, const int threadCount)
+    {
+        omp_set_num_threads(threadCount);
+        printf("Chosen neighborhood: %s\nChosen merge method: %s\n", std::to_string(neighborhoodMethod).c_str(), std::to_string(mergeMethod).c_str());
+        printf("Seed: %llu\n", (unsigned long long)header.seed);
+        printf("Band rows: %u\n", bandRows);
+        printf("Initial generation score: %f\n", get_score_of_generation());
+
+        StopwatchData s;
+        for (int generation = (int)header.generation + 1; generation <= maxGenerationCount; generation++)
+        {
+            start_stopwatch(s);
+            evolution_step();
+            stop_stopwatch(s);
+
+            printf("Completed generation %i; Score: %f; Fitness min %u, max %u, variance %f; Iteration time %f ms\n",
+                   generation, get_score_of_generation(), statistics.min, statistics.max, statistics.variance(), elapsed_milliseconds(s));
+            if (phaseTimers.is_enabled())
+            {
+                phaseTimers.collect();
+                phaseTimers.print_generation();
+            }
+
+            if (statistics.optimalCount == statistics.count)
+            {
+                printf("Target objective was reached.\n");
+                break;
+            }
+        }
+    }
+
+    // Evolves one generation from the store into its replacement.
+    void evolution_step()
+    {
+        std::unique_ptr<FILE, int (*)(FILE *)> input(fopen(filename.c_str(), "rb"), fclose);
+        if (input == nullptr)
+            throw std::runtime_error("Unable to open file " + filename);
+
+        CheckpointHeader nextHeader = header;
+        nextHeader.generation = header.generation + 1;
+        CheckpointWriter writer(filename, nextHeader);
+        FitnessStatistics nextStatistics;
+
+        uint bandCount = (rowCount + bandRows - 1) / bandRows;
+        load_band(input.get(), bands[0], 0);
+        for (uint band = 0; band < bandCount; band++)
+        {
+            std::future<void> prefetch;
+            if (band + 1 < bandCount)
+            {
+                PopulationBand &nextBand = bands[(band + 1) % 2];
+                FILE *file = input.get();
+                uint nextRowFrom = (band + 1) * bandRows;
+                prefetch = std::async(std::launch::async, [this, file, &nextBand, nextRowFrom]() { load_band(file, nextBand, nextRowFrom); });
+            }
+
+            nextStatistics.merge(evolve_band(bands[band % 2], nextHeader.generation, writer, nextHeader));
+            if (prefetch.valid())
+                prefetch.get();
+        }
+        input.reset();
+
+        store_statistics(nextHeader, nextStatistics);
+        writer.update_header(nextHeader);
+        writer.commit();
+        header = nextHeader;
+        statistics = nextStatistics;
+    }
+
+    double get_score_of_generation() const
+    {
+        assert(statistics.count == (uint64_t)rowCount * colCount);
+        return statistics.mean() / MAX_FITNESS_VALUE;
+    }
+
+    const FitnessStatistics &get_statistics_of_generation() const
+    {
+        return statistics;
+    }
+
+    uint get_current_generation() const
+    {
+        return header.generation;
+    }
+
+    void set_phase_timing(const bool enabled)
+    {
+        phaseTimers.set_enabled(enabled);
+    }
+
+    const PhaseTimers &get_phase_timers() const
+    {
+        return phaseTimers;
+    }
+
+private:
+    std::string filename;
+    CheckpointHeader header;
+    FitnessStatistics statistics;
+    uint rowCount;
+    uint colCount;
+    NeighborhoodType neighborhoodMethod;
+    PopulationMergeType mergeMethod;
+    PhaseTimers phaseTimers;
+
+    uint radius;
+    uint bandRows;
+    // Halo rows of loaded bands and rows of offspring computed on each side of the band.
+    uint haloRows;
+    uint offspringHaloRows;
+
+    // Band being evolved and band being prefetched.
+    PopulationBand bands[2];
+    PlanarPopulation offspring;
+    PlanarPopulation merged;
+    std::vector<uint> replaceTargets;
+    std::vector<uint> offspringPriorities;
+    ReplacementSlots replacementSlots;
+
+    static bool seek_end(FILE *file)
+    {
+#if defined(CHECKPOINT_MMAP)
+        return fseeko(file, 0, SEEK_END) == 0;
+#elif defined(_WIN32)
+        return _fseeki64(file, 0, SEEK_END) == 0;
+#else
+        return fseek(file, 0, SEEK_END) == 0;
+#endif
+    }
+
+    static uint64_t file_position(FILE *file)
+    {
+#if defined(CHECKPOINT_MMAP)
+        return (uint64_t)ftello(file);
+#elif defined(_WIN32)
+        return (uint64_t)_ftelli64(file);
+#else
+        return (uint64_t)ftell(file);
+#endif
+    }
+
+    static FitnessStatistics load_statistics(const CheckpointHeader &header)
+    {
+        FitnessStatistics loaded;
+        loaded.count = header.count;
+        loaded.sum = header.sum;
+        loaded.sumOfSquares = header.sumOfSquares;
+        loaded.optimalCount = header.optimalCount;
+        loaded.min = (ushort)header.minFitness;
+        loaded.max = (ushort)header.maxFitness;
+        return loaded;
+    }
+
+    static void store_statistics(CheckpointHeader &header, const FitnessStatistics &stored)
+    {
+        header.count = stored.count;
+        header.sum = stored.sum;
+        header.sumOfSquares = stored.sumOfSquares;
+        header.optimalCount = stored.optimalCount;
+        header.minFitness = stored.min;
+        header.maxFitness = stored.max;
+    }
+
+    // Writes the first rowCount rows of the unpadded population to grid rows starting at gridRowFrom.
+    static void write_rows(CheckpointWriter &writer, const CheckpointHeader &header, const PlanarPopulation &population, const uint gridRowFrom, const uint rowCount)
+    {
+        assert(population.halo == 0);
+        uint64_t cellFrom = (uint64_t)gridRowFrom * header.colCount;
+        size_t cellCount = (size_t)rowCount * header.colCount;
+        writer.write_at(header.redOffset + cellFrom, population.R.data(), cellCount);
+        writer.write_at(header.greenOffset + cellFrom, population.G.data(), cellCount);
+        writer.write_at(header.blueOffset + cellFrom, population.B.data(), cellCount);
+        writer.write_at(header.fitnessOffset + (cellFrom * sizeof(ushort)), population.fitness.data(), cellCount * sizeof(ushort));
+    }
+
+    template <typename T>
+    void read_plane(FILE *input, const uint64_t planeOffset, PopulationBand &band, Plane<T> &plane) const
+    {
+        // Loaded rows are consecutive grid rows except where the halo wraps around the torus.
+        for (uint row = 0; row < band.rows.rowCount; row++)
+        {
+            if ((row == 0) || (band.gridRows[row] != band.gridRows[row - 1] + 1))
+            {
+                if (!seek_checkpoint(input, planeOffset + ((uint64_t)band.gridRows[row] * colCount * sizeof(T))))
+                    throw std::runtime_error("Unable to read " + filename);
+            }
+            if (fread(&plane[band.rows.index(row, 0)], sizeof(T), colCount, input) != colCount)
+                throw std::runtime_error("Unable to read " + filename);
+        }
+    }
+
+    void load_band(FILE *input, PopulationBand &band, const uint gridRowFrom) const
+    {
+        band.gridRowFrom = gridRowFrom;
+        band.rowCount = std::min(bandRows, rowCount - gridRowFrom);
+
+        uint loadedRows = band.rowCount + (2 * haloRows);
+        if ((band.rows.rowCount != loadedRows) || (band.rows.colCount != colCount))
+            band.rows.resize(loadedRows, colCount, HALO_SIZE);
+        band.gridRows.resize(loadedRows);
+        for (uint row = 0; row < loadedRows; row++)
+        {
+            int64_t gridRow = ((int64_t)gridRowFrom + row - haloRows) % (int64_t)rowCount;
+            band.gridRows[row] = (uint)((gridRow < 0) ? (gridRow + rowCount) : gridRow);
+        }
+
+        read_plane(input, header.redOffset, band, band.rows.R);
+        read_plane(input, header.greenOffset, band, band.rows.G);
+        read_plane(input, header.blueOffset, band, band.rows.B);
+        read_plane(input, header.fitnessOffset, band, band.rows.fitness);
+        band.rows.refresh_halo();
+    }
+
+    FitnessStatistics evolve_band(const PopulationBand &band, const uint generation, CheckpointWriter &writer, const CheckpointHeader &nextHeader)
+    {
+        uint offspringRows = band.rowCount + (2 * offspringHaloRows);
+        if ((offspring.rowCount != offspringRows) || (offspring.colCount != colCount))
+            offspring.resize(offspringRows, colCount);
+
+        FitnessStatistics offspringStatistics;
+        switch (neighborhoodMethod)
+        {
+        case L5:
+            offspringStatistics = select_band_merge<L5>(band, generation);
+            break;
+        case L9:
+            offspringStatistics = select_band_merge<L9>(band, generation);
+            break;
+        case C9:
+            offspringStatistics = select_band_merge<C9>(band, generation);
+            break;
+        case C13:
+            offspringStatistics = select_band_merge<C13>(band, generation);
+            break;
+        default:
+            assert(false && "Wrong neighborhood type.");
+        }
+
+        if (mergeMethod == ReplaceAll)
+        {
+            write_rows(writer, nextHeader, offspring, band.gridRowFrom, band.rowCount);
+            return offspringStatistics;
+        }
+
+        FitnessStatistics mergedStatistics = merge_band(band);
+        write_rows(writer, nextHeader, merged, band.gridRowFrom, band.rowCount);
+        return mergedStatistics;
+    }
+
+    template <NeighborhoodType Type>
+    FitnessStatistics select_band_merge(const PopulationBand &band, const uint generation)
+    {
+        switch (mergeMethod)
+        {
+        case ReplaceAll:
+            return evolve_band_rows<Type, ReplaceAll>(band, generation);
+        case ReplaceWorstInNeighborhood:
+            return evolve_band_rows<Type, ReplaceWorstInNeighborhood>(band, generation);
+        case ReplaceOneParent:
+            return evolve_band_rows<Type, ReplaceOneParent>(band, generation);
+        default:
+            assert(false && "Wrong merge method.");
+            return FitnessStatistics();
+        }
+    }
+
+    // Offspring rows are evolved in the same way as rows of CellularGrid::evolve_planar_rows().
+    template <NeighborhoodType Type, PopulationMergeType Merge>
+    FitnessStatistics evolve_band_rows(const PopulationBand &band, const uint generation)
+    {
+        const PlanarPopulation &current = band.rows;
+        const uint offspringRowFrom = haloRows - offspringHaloRows;
+        if (Merge != ReplaceAll)
+        {
+            replaceTargets.resize(offspring.plane_size());
+            prioritize_offspring_rows(band);
+        }
+
+        FitnessStatistics offspringStatistics;
+#pragma omp parallel for reduction(merge_statistics : offspringStatistics)
+        for (uint row = 0; row < offspring.rowCount; row++)
+        {
+            thread_local ParentRows parentRows;
+            thread_local NeighborhoodBatch<Type> batch;
+            parentRows.resize(colCount);
+
+            uint bandRow = offspringRowFrom + row;
+            uint64_t gridRowStart = (uint64_t)band.gridRows[bandRow] * colCount;
+            uint rowStart = current.index(bandRow, 0);
+            uint offspringRowStart = offspring.index(row, 0);
+            for (uint batchFrom = 0; batchFrom < colCount; batchFrom += SELECTION_BATCH)
+            {
+                uint batchTo = std::min(batchFrom + SELECTION_BATCH, colCount);
+                uint count = batchTo - batchFrom;
+
+                uint64_t phaseStart = phaseTimers.start();
+                for_each_neighborhood_in_padded_row<Type>(current, rowStart, batchFrom, batchTo, current.stride, [&](const uint col, const Neighborhood &neighborhood) {
+                    batch.set(col - batchFrom, neighborhood);
+                });
+                phaseStart = phaseTimers.lap(GatherPhase, phaseStart);
+
+                uint32_t rotationDraws[SELECTION_BATCH];
+                uint32_t replaceDraws[SELECTION_BATCH];
+                for (uint lane = 0; lane < count; lane++)
+                {
+                    CounterRandom random(header.seed, generation, gridRowStart + batchFrom + lane);
+                    batch.drawA[lane] = random();
+                    batch.drawB[lane] = random();
+                    rotationDraws[lane] = random();
+                    replaceDraws[lane] = random();
+                }
+
+                select_parents_batch(batch, count);
+                if constexpr (Merge == ReplaceWorstInNeighborhood)
+                    select_worst_batch(batch, count);
+
+                for (uint lane = 0; lane < count; lane++)
+                {
+                    uint col = batchFrom + lane;
+                    uint first = batch.index[batch.slotA[lane]][lane];
+                    uint second = batch.index[batch.slotB[lane]][lane];
+
+                    parentRows.firstR[col] = current.R[first];
+                    parentRows.firstG[col] = current.G[first];
+                    parentRows.firstB[col] = current.B[first];
+                    parentRows.secondR[col] = current.R[second];
+                    parentRows.secondG[col] = current.G[second];
+                    parentRows.secondB[col] = current.B[second];
+                    parentRows.rotation[col] = (uchar)scale_draw(rotationDraws[lane], 3);
+
+                    if constexpr (Merge == ReplaceWorstInNeighborhood)
+                        replaceTargets[offspringRowStart + col] = band_target(band, batch.index[batch.worstSlot[lane]][lane]);
+                    else if constexpr (Merge == ReplaceOneParent)
+                        replaceTargets[offspringRowStart + col] = band_target(band, (scale_draw(replaceDraws[lane], 2) == 0) ? first : second);
+                }
+                phaseTimers.stop(SelectionPhase, phaseStart);
+            }
+
+            uint64_t phaseStart = phaseTimers.start();
+            reproduce_row(parentRows, 0, colCount, &offspring.R[offspringRowStart], &offspring.G[offspringRowStart], &offspring.B[offspringRowStart],
+                          &offspring.fitness[offspringRowStart]);
+            phaseStart = phaseTimers.lap(ReproductionPhase, phaseStart);
+            offspringStatistics.add_row(&offspring.fitness[offspringRowStart], colCount);
+            phaseTimers.stop(ScoringPhase, phaseStart);
+        }
+        return offspringStatistics;
+    }
+
+    // Maps a cell index of the loaded band to its index among the band rows, cells outside of them aren't replaced by this band.
+    uint band_target(const PopulationBand &band, const uint index) const
+    {
+        uint target = band.rows.wrap_index(index);
+        uint gridRow = band.gridRows[(target / band.rows.stride) - band.rows.halo];
+        uint row = (gridRow >= band.gridRowFrom) ? (gridRow - band.gridRowFrom) : (gridRow + rowCount - band.gridRowFrom);
+        if (row >= band.rowCount)
+            return NO_REPLACE_TARGET;
+        return (row * colCount) + (target % band.rows.stride) - band.rows.halo;
+    }
+
+    // Serial replacement keeps the offspring with the highest row-major grid index, offspring rows are ranked by their grid rows,
+    // so that the rows wrapped around the torus compete in the same order.
+    void prioritize_offspring_rows(const PopulationBand &band)
+    {
+        const uint offspringRowFrom = haloRows - offspringHaloRows;
+        std::vector<uint> sortedRows(band.gridRows.begin() + offspringRowFrom, band.gridRows.begin() + offspringRowFrom + offspring.rowCount);
+        std::sort(sortedRows.begin(), sortedRows.end());
+        sortedRows.erase(std::unique(sortedRows.begin(), sortedRows.end()), sortedRows.end());
+
+        offspringPriorities.resize(offspring.rowCount);
+        for (uint row = 0; row < offspring.rowCount; row++)
+        {
+            uint gridRow = band.gridRows[offspringRowFrom + row];
+            offspringPriorities[row] = (uint)(std::lower_bound(sortedRows.begin(), sortedRows.end(), gridRow) - sortedRows.begin());
+        }
+    }
+
+    FitnessStatistics merge_band(const PopulationBand &band)
+    {
+        PhaseTimer timer(phaseTimers, ReplacementPhase);
+        if ((merged.rowCount != band.rowCount) || (merged.colCount != colCount))
+            merged.resize(band.rowCount, colCount);
+        if (replacementSlots.slots.size() != merged.plane_size())
+            replacementSlots.resize(merged.plane_size());
+
+#pragma omp parallel for
+        for (uint row = 0; row < offspring.rowCount; row++)
+        {
+            uint rowStart = offspring.index(row, 0);
+            for (uint col = 0; col < colCount; col++)
+            {
+                uint target = replaceTargets[rowStart + col];
+                if (target != NO_REPLACE_TARGET)
+                    replacementSlots.offer(target, (offspringPriorities[row] * colCount) + col, offspring.R[rowStart + col], offspring.G[rowStart + col],
+                                           offspring.B[rowStart + col]);
+            }
+        }
+
+        uchar r, g, b;
+        FitnessStatistics mergedStatistics;
+#pragma omp parallel for private(r, g, b) reduction(merge_statistics : mergedStatistics)
+        for (uint row = 0; row < merged.rowCount; row++)
+        {
+            uint rowStart = merged.index(row, 0);
+            uint currentRowStart = band.rows.index(haloRows + row, 0);
+            for (uint col = 0; col < colCount; col++)
+            {
+                if (replacementSlots.take(rowStart + col, r, g, b))
+                    merged.set(rowStart + col, r, g, b);
+                else
+                    merged.copy_cell(rowStart + col, band.rows, currentRowStart + col);
+            }
+            mergedStatistics.add_row(&merged.fitness[rowStart], colCount);
+        }
+        return mergedStatistics;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+#include "cell.h"
+#include <stdint.h>
+#include <vector>
+
+// Genome packed into a single 32-bit word, R in the lowest byte, then G and B.
+// Highest byte is left for flags. Fitness doesn't fit into a byte, so it is summed from the channels when needed.
+// Location is not stored, it is derived from the index, and cells replaced by offspring are kept in a separate index array.
+struct PackedCell
+{
+    uint32_t bits;
+
+    PackedCell()
+    {
+        bits = 0;
+    }
+
+    PackedCell(const uchar r, const uchar g, const uchar b)
+    {
+        bits = (uint32_t)r | ((uint32_t)g << 8) | ((uint32_t)b << 16);
+    }
+
+    inline uchar red() const
+    {
+        return (uchar)bits;
+    }
+
+    inline uchar green() const
+    {
+        return (uchar)(bits >> 8);
+    }
+
+    inline uchar blue() const
+    {
+        return (uchar)(bits >> 16);
+    }
+
+    inline ushort fitness() const
+    {
+        return (ushort)(red() + green() + blue());
+    }
+};
+
+static_assert(sizeof(PackedCell) == 4, "Packed cell has to fit into 4 bytes.");
+
+typedef std::vector<PackedCell> PackedPopulation;
\ No newline at end of file
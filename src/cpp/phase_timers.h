@@ -0,0 +1,167 @@
+#pragma once
+#include "stopwatch.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+enum TimedPhase
+{
+    GatherPhase,
+    SelectionPhase,
+    ReproductionPhase,
+    // Gather, selection and reproduction of kernels which interleave them cell by cell, sweeps include their in-place replacement.
+    BreedingPhase,
+    ReplacementPhase,
+    ScoringPhase,
+    SnapshotPhase,
+    TIMED_PHASE_COUNT
+};
+
+constexpr const char *TIMED_PHASE_NAMES[TIMED_PHASE_COUNT] = {"gather", "selection", "reproduction", "breeding", "replacement", "scoring", "snapshot"};
+
+// Threads beyond this count share accumulators with earlier threads.
+constexpr unsigned int MAX_TIMED_THREADS = 256;
+
+// Accumulators of one thread take a whole cache line, so that timing threads don't invalidate each other's lines.
+struct alignas(64) PhaseAccumulator
+{
+    uint64_t nanoseconds[TIMED_PHASE_COUNT];
+};
+
+// Nanosecond timers of the phases of a generation.
+// Every thread adds to its own accumulator and collect() sums them once the generation is complete,
+// so per-phase times are thread time summed over threads, not wall time.
+// Disabled timers don't read the clock, a timed phase then costs a single predictable branch.
+class PhaseTimers
+{
+public:
+    PhaseTimers()
+    {
+        enabled = false;
+        accumulators.resize(MAX_TIMED_THREADS);
+        reset();
+    }
+
+    void set_enabled(const bool enabled)
+    {
+        this->enabled = enabled;
+    }
+
+    bool is_enabled() const
+    {
+        return enabled;
+    }
+
+    // Clears all accumulated times.
+    void reset()
+    {
+        for (PhaseAccumulator &accumulator : accumulators)
+            std::fill(accumulator.nanoseconds, accumulator.nanoseconds + TIMED_PHASE_COUNT, 0);
+        std::fill(generationTimes, generationTimes + TIMED_PHASE_COUNT, 0);
+        std::fill(totalTimes, totalTimes + TIMED_PHASE_COUNT, 0);
+    }
+
+    inline uint64_t start() const
+    {
+        return enabled ? now_nanoseconds() : 0;
+    }
+
+    inline void stop(const TimedPhase phase, const uint64_t startTime)
+    {
+        if (enabled)
+            add(phase, now_nanoseconds() - startTime);
+    }
+
+    // Ends the phase started at startTime and starts the next one, consecutive phases read the clock once per boundary.
+    inline uint64_t lap(const TimedPhase phase, const uint64_t startTime)
+    {
+        if (!enabled)
+            return 0;
+        uint64_t now = now_nanoseconds();
+        add(phase, now - startTime);
+        return now;
+    }
+
+    // Moves accumulated times of all threads into the times of the generation, no phase may be running.
+    void collect()
+    {
+        if (!enabled)
+            return;
+        for (int phase = 0; phase < TIMED_PHASE_COUNT; phase++)
+        {
+            generationTimes[phase] = 0;
+            for (PhaseAccumulator &accumulator : accumulators)
+            {
+                generationTimes[phase] += accumulator.nanoseconds[phase];
+                accumulator.nanoseconds[phase] = 0;
+            }
+            totalTimes[phase] += generationTimes[phase];
+        }
+    }
+
+    uint64_t generation_nanoseconds(const TimedPhase phase) const
+    {
+        return generationTimes[phase];
+    }
+
+    uint64_t total_nanoseconds(const TimedPhase phase) const
+    {
+        return totalTimes[phase];
+    }
+
+    // Prints phases which took any time in the last collected generation.
+    void print_generation() const
+    {
+        printf("Phase times:");
+        for (int phase = 0; phase < TIMED_PHASE_COUNT; phase++)
+        {
+            if (generationTimes[phase] > 0)
+                printf(" %s %f ms;", TIMED_PHASE_NAMES[phase], generationTimes[phase] / 1e6);
+        }
+        printf("\n");
+    }
+
+private:
+    bool enabled;
+    std::vector<PhaseAccumulator> accumulators;
+    uint64_t generationTimes[TIMED_PHASE_COUNT];
+    uint64_t totalTimes[TIMED_PHASE_COUNT];
+
+    inline void add(const TimedPhase phase, const uint64_t nanoseconds)
+    {
+        // Accumulator is shared only by threads past MAX_TIMED_THREADS, the relaxed add is uncontended otherwise.
+        __atomic_fetch_add(&accumulators[thread_slot()].nanoseconds[phase], nanoseconds, __ATOMIC_RELAXED);
+    }
+
+    static unsigned int thread_slot()
+    {
+        static std::atomic<unsigned int> nextSlot(0);
+        thread_local unsigned int slot = nextSlot.fetch_add(1) % MAX_TIMED_THREADS;
+        return slot;
+    }
+};
+
+// Times the enclosing scope as one phase.
+class PhaseTimer
+{
+public:
+    PhaseTimer(PhaseTimers &timers, const TimedPhase phase) : timers(timers), phase(phase)
+    {
+        startTime = timers.start();
+    }
+
+    ~PhaseTimer()
+    {
+        timers.stop(phase, startTime);
+    }
+
+    PhaseTimer(const PhaseTimer &) = delete;
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+private:
+    PhaseTimers &timers;
+    const TimedPhase phase;
+    uint64_t startTime;
+};
\ No newline at end of file
@@ -0,0 +1,336 @@
+#pragma once
+#include "cell.h"
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+// Width of the ghost border of padded populations, it covers the largest stencil radius.
+constexpr uint HALO_SIZE = 2;
+
+// Elements of one plane of a population. Plane either owns its elements, or uses elements of a private file mapping,
+// whose pages are then read on first touch and copied on first write.
+// Owned elements are zero-filled by calloc(), which leaves pages of large planes untouched until they are used.
+template <typename T>
+class Plane
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Plane elements are moved as bytes.");
+
+public:
+    Plane()
+    {
+        elements = nullptr;
+        count = 0;
+        capacity = 0;
+    }
+
+    Plane(const Plane &other) : Plane()
+    {
+        resize(other.count);
+        std::copy(other.begin(), other.end(), elements);
+    }
+
+    Plane(Plane &&other) : Plane()
+    {
+        swap(other);
+    }
+
+    ~Plane()
+    {
+        release();
+    }
+
+    Plane &operator=(const Plane &other)
+    {
+        Plane copy(other);
+        swap(copy);
+        return *this;
+    }
+
+    Plane &operator=(Plane &&other)
+    {
+        Plane moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+
+    // Keeps elements up to the new size, added elements are zero. Mapped elements are copied to owned storage.
+    void resize(const size_t size)
+    {
+        if (!mapping && (size <= capacity))
+        {
+            if (size > count)
+                std::fill(elements + count, elements + size, T());
+            count = size;
+            return;
+        }
+
+        T *resized = (T *)calloc(std::max<size_t>(size, 1), sizeof(T));
+        if (resized == nullptr)
+            throw std::bad_alloc();
+        std::copy(elements, elements + std::min(count, size), resized);
+        release();
+        elements = resized;
+        count = size;
+        capacity = size;
+    }
+
+    // Uses size elements of a mapping instead of owned ones, the plane keeps the mapping alive while it uses them.
+    void map(T *mapped, const size_t size, const std::shared_ptr<void> &mapping)
+    {
+        release();
+        elements = mapped;
+        count = size;
+        this->mapping = mapping;
+    }
+
+    void swap(Plane &other)
+    {
+        std::swap(elements, other.elements);
+        std::swap(count, other.count);
+        std::swap(capacity, other.capacity);
+        mapping.swap(other.mapping);
+    }
+
+    inline T &operator[](const size_t index)
+    {
+        return elements[index];
+    }
+
+    inline const T &operator[](const size_t index) const
+    {
+        return elements[index];
+    }
+
+    T *data()
+    {
+        return elements;
+    }
+
+    const T *data() const
+    {
+        return elements;
+    }
+
+    T *begin()
+    {
+        return elements;
+    }
+
+    T *end()
+    {
+        return elements + count;
+    }
+
+    const T *begin() const
+    {
+        return elements;
+    }
+
+    const T *end() const
+    {
+        return elements + count;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+private:
+    T *elements;
+    size_t count;
+    size_t capacity;
+    std::shared_ptr<void> mapping;
+
+    void release()
+    {
+        if (!mapping)
+            free(elements);
+        mapping.reset();
+        elements = nullptr;
+        count = 0;
+        capacity = 0;
+    }
+};
+
+// Population stored as separate contiguous R, G, B and fitness planes.
+// Cell location is not stored, it is derived from the index.
+// Padded populations surround the grid with a halo, which mirrors the opposite edges of the toroidal grid,
+// so that stencil reads never have to wrap around.
+struct PlanarPopulation
+{
+    uint rowCount;
+    uint colCount;
+    uint halo;
+    uint stride;
+
+    Plane<uchar> R;
+    Plane<uchar> G;
+    Plane<uchar> B;
+    Plane<ushort> fitness;
+
+    PlanarPopulation()
+    {
+        rowCount = 0;
+        colCount = 0;
+        halo = 0;
+        stride = 0;
+    }
+
+    PlanarPopulation(const uint rowCount, const uint colCount, const uint halo = 0)
+    {
+        resize(rowCount, colCount, halo);
+    }
+
+    void resize(const uint rowCount, const uint colCount, const uint halo = 0)
+    {
+        // Halo mirrors the opposite edge of the grid, a thinner grid doesn't have enough cells to fill it.
+        if ((halo > rowCount) || (halo > colCount))
+            throw std::invalid_argument("Population halo is wider than the grid.");
+        this->rowCount = rowCount;
+        this->colCount = colCount;
+        this->halo = halo;
+        this->stride = colCount + (2 * halo);
+
+        size_t planeSize = (size_t)(rowCount + (2 * halo)) * stride;
+        R.resize(planeSize);
+        G.resize(planeSize);
+        B.resize(planeSize);
+        fitness.resize(planeSize);
+    }
+
+    // Number of grid cells, halo excluded.
+    size_t size() const
+    {
+        return (size_t)rowCount * colCount;
+    }
+
+    // Number of elements of every plane, halo included.
+    size_t plane_size() const
+    {
+        return fitness.size();
+    }
+
+    inline uint index(const uint row, const uint col) const
+    {
+        return ((row + halo) * stride) + col + halo;
+    }
+
+    inline Point location(const uint index) const
+    {
+        return Point((index % stride) - halo, (index / stride) - halo);
+    }
+
+    // Maps index of a halo cell to the index of the grid cell it mirrors.
+    inline uint wrap_index(const uint index) const
+    {
+        if (halo == 0)
+            return index;
+
+        uint row = index / stride;
+        uint col = index % stride;
+        row = (row < halo) ? (row + rowCount) : ((row >= rowCount + halo) ? (row - rowCount) : row);
+        col = (col < halo) ? (col + colCount) : ((col >= colCount + halo) ? (col - colCount) : col);
+        return (row * stride) + col;
+    }
+
+    inline void set(const uint index, const uchar r, const uchar g, const uchar b)
+    {
+        R[index] = r;
+        G[index] = g;
+        B[index] = b;
+        fitness[index] = (ushort)(r + g + b);
+    }
+
+    // Sets a grid cell together with its copies in the halo, so that the halo stays valid without refresh_halo().
+    // Index may point into the halo. Cells of grids narrower than two halos have copies on both sides,
+    // so every shift of the grid cell by the grid size is tried.
+    void set_mirrored(const uint index, const uchar r, const uchar g, const uchar b)
+    {
+        uint cellIndex = wrap_index(index);
+        set(cellIndex, r, g, b);
+        if (halo == 0)
+            return;
+
+        int row = (int)(cellIndex / stride) - (int)halo;
+        int col = (int)(cellIndex % stride) - (int)halo;
+        for (int rowShift = -1; rowShift <= 1; rowShift++)
+        {
+            int mirrorRow = row + (rowShift * (int)rowCount);
+            if ((mirrorRow < -(int)halo) || (mirrorRow >= (int)(rowCount + halo)))
+                continue;
+
+            for (int colShift = -1; colShift <= 1; colShift++)
+            {
+                int mirrorCol = col + (colShift * (int)colCount);
+                if (((rowShift == 0) && (colShift == 0)) || (mirrorCol < -(int)halo) || (mirrorCol >= (int)(colCount + halo)))
+                    continue;
+                set(((mirrorRow + halo) * stride) + mirrorCol + halo, r, g, b);
+            }
+        }
+    }
+
+    inline void copy_cell(const uint index, const PlanarPopulation &source, const uint sourceIndex)
+    {
+        R[index] = source.R[sourceIndex];
+        G[index] = source.G[sourceIndex];
+        B[index] = source.B[sourceIndex];
+        fitness[index] = source.fitness[sourceIndex];
+    }
+
+    Cell get_cell(const uint index) const
+    {
+        return Cell(location(index), R[index], G[index], B[index]);
+    }
+
+    // Copies opposite grid edges into the halo, has to be called after every change of the grid.
+    void refresh_halo()
+    {
+        if (halo == 0)
+            return;
+
+        for (uint row = 0; row < rowCount; row++)
+        {
+            uint rowStart = index(row, 0);
+            for (uint k = 0; k < halo; k++)
+            {
+                copy_cell(rowStart - halo + k, *this, rowStart + colCount - halo + k);
+                copy_cell(rowStart + colCount + k, *this, rowStart + k);
+            }
+        }
+
+        // Whole padded rows are copied, so the corners are refreshed too.
+        for (uint k = 0; k < halo; k++)
+        {
+            copy_row(k, rowCount + k);
+            copy_row(rowCount + halo + k, halo + k);
+        }
+    }
+
+    void swap(PlanarPopulation &other)
+    {
+        std::swap(rowCount, other.rowCount);
+        std::swap(colCount, other.colCount);
+        std::swap(halo, other.halo);
+        std::swap(stride, other.stride);
+        R.swap(other.R);
+        G.swap(other.G);
+        B.swap(other.B);
+        fitness.swap(other.fitness);
+    }
+
+private:
+    void copy_row(const uint paddedRow, const uint sourcePaddedRow)
+    {
+        size_t to = (size_t)paddedRow * stride;
+        size_t from = (size_t)sourcePaddedRow * stride;
+        std::copy(R.begin() + from, R.begin() + from + stride, R.begin() + to);
+        std::copy(G.begin() + from, G.begin() + from + stride, G.begin() + to);
+        std::copy(B.begin() + from, B.begin() + from + stride, B.begin() + to);
+        std::copy(fitness.begin() + from, fitness.begin() + from + stride, fitness.begin() + to);
+    }
+};
\ No newline at end of file
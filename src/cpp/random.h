@@ -0,0 +1,107 @@
+#pragma once
+#include <stdint.h>
+#include <random>
+
+// Counter-based Philox4x32-10 generator (Salmon et al., Parallel Random Numbers: As Easy as 1, 2, 3).
+// Output is a pure function of key and counter, so a generator is free to construct,
+// holds no shared state and every (seed, generation, cell) triple gets its own independent stream.
+// Satisfies UniformRandomBitGenerator, so it can be plugged in wherever std::mt19937 was used.
+class CounterRandom
+{
+public:
+    typedef uint32_t result_type;
+
+    // Cell indices of grids with more than 2^32 cells continue in the upper half of the stream word,
+    // so the streams of smaller grids don't depend on whether they are evolved in memory or out of core.
+    CounterRandom(const uint64_t seed, const uint32_t generation, const uint64_t cellIndex, const uint32_t stream = 0)
+    {
+        key[0] = (uint32_t)seed;
+        key[1] = (uint32_t)(seed >> 32);
+        counter[0] = (uint32_t)cellIndex;
+        counter[1] = generation;
+        counter[2] = stream | ((uint32_t)(cellIndex >> 32) << 16);
+        counter[3] = 0;
+        position = 4;
+    }
+
+    static constexpr result_type min()
+    {
+        return 0;
+    }
+
+    static constexpr result_type max()
+    {
+        return UINT32_MAX;
+    }
+
+    inline result_type operator()()
+    {
+        if (position == 4)
+        {
+            generate_block();
+            counter[3]++;
+            position = 0;
+        }
+        return block[position++];
+    }
+
+private:
+    uint32_t key[2];
+    uint32_t counter[4];
+    uint32_t block[4];
+    int position;
+
+    static inline void multiply(const uint32_t a, const uint32_t b, uint32_t &hi, uint32_t &lo)
+    {
+        uint64_t product = (uint64_t)a * b;
+        hi = (uint32_t)(product >> 32);
+        lo = (uint32_t)product;
+    }
+
+    inline void generate_block()
+    {
+        uint32_t x[4] = {counter[0], counter[1], counter[2], counter[3]};
+        uint32_t k0 = key[0];
+        uint32_t k1 = key[1];
+        uint32_t hi0, lo0, hi1, lo1;
+
+        for (int round = 0; round < 10; round++)
+        {
+            multiply(0xD2511F53u, x[0], hi0, lo0);
+            multiply(0xCD9E8D57u, x[2], hi1, lo1);
+
+            x[0] = hi1 ^ x[1] ^ k0;
+            x[1] = lo1;
+            x[2] = hi0 ^ x[3] ^ k1;
+            x[3] = lo0;
+
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+
+        block[0] = x[0];
+        block[1] = x[1];
+        block[2] = x[2];
+        block[3] = x[3];
+    }
+};
+
+// Maps a 32-bit draw to [0, bound) by multiply-shift, bias is at most bound / 2^32.
+// Unlike std::uniform_int_distribution the result is the same with every standard library.
+inline uint32_t scale_draw(const uint32_t draw, const uint32_t bound)
+{
+    return (uint32_t)(((uint64_t)draw * bound) >> 32);
+}
+
+template <typename Random>
+inline uint32_t random_below(Random &random, const uint32_t bound)
+{
+    return scale_draw(random(), bound);
+}
+
+// Fresh seed for runs which don't need to be repeated.
+inline uint64_t random_seed()
+{
+    std::random_device randomDevice;
+    return ((uint64_t)randomDevice() << 32) | randomDevice();
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+#include "cell.h"
+#include <vector>
+#include <stdint.h>
+
+inline void atomic_max(uint64_t &target, const uint64_t value)
+{
+    uint64_t current = __atomic_load_n(&target, __ATOMIC_RELAXED);
+    while ((current < value) && !__atomic_compare_exchange_n(&target, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+// Lock-free placement of offspring into the cells they replace.
+// Every target cell owns a 64-bit slot packing (priority, genome) and offspring compete for it with an atomic maximum.
+// Priority is the row-major index of the offspring, so the winner is the one a serial row-major replacement keeps.
+struct ReplacementSlots
+{
+    std::vector<uint64_t> slots;
+
+    ReplacementSlots()
+    {
+    }
+
+    ReplacementSlots(const size_t size)
+    {
+        resize(size);
+    }
+
+    void resize(const size_t size)
+    {
+        slots.assign(size, 0);
+    }
+
+    inline void offer(const uint target, const uint offspringIndex, const uchar r, const uchar g, const uchar b)
+    {
+        uint64_t packed = ((uint64_t)(offspringIndex + 1) << 32) | ((uint)r << 16) | ((uint)g << 8) | b;
+        atomic_max(slots[target], packed);
+    }
+
+    // Returns whether some offspring claimed the target and empties the slot for the next generation.
+    inline bool take(const uint target, uchar &r, uchar &g, uchar &b)
+    {
+        uint64_t packed = slots[target];
+        if (packed == 0)
+            return false;
+
+        slots[target] = 0;
+        r = (uchar)(packed >> 16);
+        g = (uchar)(packed >> 8);
+        b = (uchar)packed;
+        return true;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "cellular_grid.h"
+#include <filesystem>
+
+// Restarts a run from its checkpoint and checks that the frame stream of the restarted run
+// holds the same frames as the stream of an uninterrupted run.
+// Restored run is preceded by generations written past the checkpoint, which the restart has to drop.
+constexpr uint GRID_SIZE = 48;
+constexpr uint CHECKPOINT_GENERATION = 10;
+constexpr uint INTERRUPTED_GENERATION = 13;
+constexpr uint LAST_GENERATION = 20;
+constexpr uint64_t SEED = 11;
+
+static void start_run(CellularGrid &grid)
+{
+    grid.initialize(L5, ReplaceAll, RandomWithDiscrimination, StructureOfArrays, SEED);
+    grid.set_snapshot_format(FrameStreamSnapshots);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <output folder>\n", argv[0]);
+        return 1;
+    }
+
+    std::string folder = argv[1];
+    std::string referenceFolder = folder + "/reference";
+    std::string restartFolder = folder + "/restart";
+    std::string checkpointFilename = folder + "/restart.ck";
+    std::filesystem::remove_all(folder);
+    std::filesystem::create_directories(referenceFolder);
+    std::filesystem::create_directories(restartFolder);
+
+    try
+    {
+        CellularGrid reference(GRID_SIZE);
+        start_run(reference);
+        reference.evolve(LAST_GENERATION, false, 1, true, referenceFolder);
+
+        // Interrupted run is checkpointed, then writes a few more frames before it is lost.
+        CellularGrid interrupted(GRID_SIZE);
+        start_run(interrupted);
+        interrupted.set_checkpointing(checkpointFilename, CHECKPOINT_GENERATION);
+        interrupted.evolve(CHECKPOINT_GENERATION, false, 1, true, restartFolder);
+        interrupted.set_checkpointing(folder + "/lost.ck", CHECKPOINT_GENERATION);
+        interrupted.evolve(INTERRUPTED_GENERATION, false, 1, true, restartFolder);
+
+        CellularGrid restarted(1);
+        restarted.restore_checkpoint(checkpointFilename);
+        restarted.set_snapshot_format(FrameStreamSnapshots);
+        restarted.evolve(LAST_GENERATION, false, 1, true, restartFolder);
+
+        FrameStreamReader expected(referenceFolder + "/generations.frames");
+        FrameStreamReader actual(restartFolder + "/generations.frames");
+        if ((actual.frame_count() != LAST_GENERATION) || (expected.frame_count() != LAST_GENERATION))
+        {
+            fprintf(stderr, "Restarted stream has %zu frames, expected %u.\n", actual.frame_count(), LAST_GENERATION);
+            return 1;
+        }
+
+        Snapshot expectedFrame, actualFrame;
+        for (size_t frame = 0; frame < actual.frame_count(); frame++)
+        {
+            expected.read(frame, expectedFrame);
+            actual.read(frame, actualFrame);
+            if ((actualFrame.generation != frame + 1) || (actualFrame.pixels != expectedFrame.pixels))
+            {
+                fprintf(stderr, "Frame %zu of generation %u differs from the uninterrupted run.\n", frame, actualFrame.generation);
+                return 1;
+            }
+        }
+        if (!actual.frame_header(CHECKPOINT_GENERATION).keyframe)
+        {
+            fprintf(stderr, "First frame after the restart is not a keyframe.\n");
+            return 1;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    printf("Restarted frame stream matches the uninterrupted run.\n");
+    return 0;
+}
\ No newline at end of file
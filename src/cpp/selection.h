@@ -0,0 +1,133 @@
+#pragma once
+#include "neighborhood.h"
+#include "random.h"
+
+// Roulette-wheel selection of two distinct neighbors from integer fitness prefix sums.
+// The first slot is picked by drawA over the whole fitness mass, the second by drawB over the mass
+// which remains without the first one, so there is no retry loop. Zero fitness neighbors are picked
+// only when the remaining mass is zero, then the choice is uniform.
+inline void select_parent_slots(const ushort *fitness, const int size, const uint32_t drawA, const uint32_t drawB, int &slotA, int &slotB)
+{
+    uint total = 0;
+    for (int i = 0; i < size; i++)
+        total += fitness[i];
+
+    uint valueA = scale_draw(drawA, total);
+    uint running = 0;
+    int a = 0;
+    for (int i = 0; i < size; i++)
+    {
+        running += fitness[i];
+        a += (running <= valueA);
+    }
+    a = (total == 0) ? (int)scale_draw(drawA, size) : a;
+
+    uint weightA = fitness[a];
+    uint remaining = total - weightA;
+    uint valueB = scale_draw(drawB, remaining);
+    running = 0;
+    int b = 0;
+    for (int i = 0; i < size; i++)
+    {
+        running += fitness[i];
+        b += ((running - ((i >= a) ? weightA : 0)) <= valueB);
+    }
+    int uniformB = (int)scale_draw(drawB, size - 1);
+    b = (remaining == 0) ? (uniformB + (uniformB >= a)) : b;
+
+    slotA = a;
+    slotB = b;
+}
+
+constexpr uint SELECTION_BATCH = 64;
+
+// Neighborhoods of a batch of consecutive cells of one row, transposed so that every stencil slot
+// is a contiguous array over the cells and selection can be vectorized across them.
+template <NeighborhoodType Type>
+struct NeighborhoodBatch
+{
+    static constexpr int size = Stencil<Type>::size;
+
+    ushort fitness[size][SELECTION_BATCH];
+    uint index[size][SELECTION_BATCH];
+
+    uint32_t drawA[SELECTION_BATCH];
+    uint32_t drawB[SELECTION_BATCH];
+    uchar slotA[SELECTION_BATCH];
+    uchar slotB[SELECTION_BATCH];
+    uchar worstSlot[SELECTION_BATCH];
+
+    inline void set(const uint lane, const Neighborhood &neighborhood)
+    {
+        for (int k = 0; k < size; k++)
+        {
+            fitness[k][lane] = neighborhood.fitness[k];
+            index[k][lane] = neighborhood.index[k];
+        }
+    }
+};
+
+// Vectorized select_parent_slots() over the first count cells of the batch, picks the same slots for the same draws.
+template <NeighborhoodType Type>
+void select_parents_batch(NeighborhoodBatch<Type> &batch, const uint count)
+{
+    constexpr int size = NeighborhoodBatch<Type>::size;
+
+#pragma omp simd
+    for (uint lane = 0; lane < count; lane++)
+    {
+        uint total = 0;
+        for (int k = 0; k < size; k++)
+            total += batch.fitness[k][lane];
+
+        uint valueA = scale_draw(batch.drawA[lane], total);
+        uint running = 0;
+        uint a = 0;
+        for (int k = 0; k < size; k++)
+        {
+            running += batch.fitness[k][lane];
+            a += (running <= valueA);
+        }
+        a = (total == 0) ? scale_draw(batch.drawA[lane], size) : a;
+
+        uint weightA = 0;
+        for (int k = 0; k < size; k++)
+            weightA = (k == (int)a) ? batch.fitness[k][lane] : weightA;
+
+        uint remaining = total - weightA;
+        uint valueB = scale_draw(batch.drawB[lane], remaining);
+        running = 0;
+        uint b = 0;
+        for (int k = 0; k < size; k++)
+        {
+            running += batch.fitness[k][lane];
+            b += ((running - ((k >= (int)a) ? weightA : 0)) <= valueB);
+        }
+        uint uniformB = scale_draw(batch.drawB[lane], size - 1);
+        b = (remaining == 0) ? (uniformB + (uniformB >= a)) : b;
+
+        batch.slotA[lane] = (uchar)a;
+        batch.slotB[lane] = (uchar)b;
+    }
+}
+
+// Vectorized get_worst_cell_index(), ties are broken towards the later slot in the same way.
+template <NeighborhoodType Type>
+void select_worst_batch(NeighborhoodBatch<Type> &batch, const uint count)
+{
+    constexpr int size = NeighborhoodBatch<Type>::size;
+
+#pragma omp simd
+    for (uint lane = 0; lane < count; lane++)
+    {
+        uint worst = 0;
+        uint worstFitness = batch.fitness[0][lane];
+        for (int k = 1; k < size; k++)
+        {
+            bool worse = (batch.fitness[k][lane] <= worstFitness);
+            worst = worse ? k : worst;
+            worstFitness = worse ? batch.fitness[k][lane] : worstFitness;
+        }
+        batch.worstSlot[lane] = (uchar)worst;
+    }
+}
\ No newline at end of file
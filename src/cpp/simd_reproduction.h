@@ -0,0 +1,183 @@
+#pragma once
+#include "cell.h"
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CGA_X86_SIMD 1
+#endif
+
+// Genomes of the already selected parents of one row, gathered into contiguous planes.
+// Rotation holds the random value of reproduction() (0, 1 or 2) for every offspring.
+struct ParentRows
+{
+    std::vector<uchar> firstR;
+    std::vector<uchar> firstG;
+    std::vector<uchar> firstB;
+    std::vector<uchar> secondR;
+    std::vector<uchar> secondG;
+    std::vector<uchar> secondB;
+    std::vector<uchar> rotation;
+
+    void resize(const uint colCount)
+    {
+        firstR.resize(colCount);
+        firstG.resize(colCount);
+        firstB.resize(colCount);
+        secondR.resize(colCount);
+        secondG.resize(colCount);
+        secondB.resize(colCount);
+        rotation.resize(colCount);
+    }
+};
+
+typedef void (*ReproduceRowFunction)(const ParentRows &parents, const uint from, const uint to, uchar *R, uchar *G, uchar *B, ushort *fitness);
+
+// Same channel mapping as reproduction(): rotation 1 feeds R from B, G from R and B from G,
+// rotation 2 feeds R from G, G from B and B from R.
+void reproduce_row_scalar(const ParentRows &parents, const uint from, const uint to, uchar *R, uchar *G, uchar *B, ushort *fitness)
+{
+    for (uint col = from; col < to; col++)
+    {
+        uchar maxR = (parents.firstR[col] > parents.secondR[col]) ? parents.firstR[col] : parents.secondR[col];
+        uchar maxG = (parents.firstG[col] > parents.secondG[col]) ? parents.firstG[col] : parents.secondG[col];
+        uchar maxB = (parents.firstB[col] > parents.secondB[col]) ? parents.firstB[col] : parents.secondB[col];
+
+        uchar rotation = parents.rotation[col];
+        R[col] = (rotation == 0) ? maxR : ((rotation == 1) ? maxB : maxG);
+        G[col] = (rotation == 0) ? maxG : ((rotation == 1) ? maxR : maxB);
+        B[col] = (rotation == 0) ? maxB : ((rotation == 1) ? maxG : maxR);
+        fitness[col] = (ushort)(R[col] + G[col] + B[col]);
+    }
+}
+
+#ifdef CGA_X86_SIMD
+
+__attribute__((target("sse2"))) inline __m128i select_sse2(const __m128i mask, const __m128i a, const __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+__attribute__((target("sse2"))) void reproduce_row_sse2(const ParentRows &parents, const uint from, const uint to, uchar *R, uchar *G, uchar *B, ushort *fitness)
+{
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i two = _mm_set1_epi8(2);
+    const __m128i zero = _mm_setzero_si128();
+
+    uint col = from;
+    for (; col + 16 <= to; col += 16)
+    {
+        __m128i maxR = _mm_max_epu8(_mm_loadu_si128((const __m128i *)&parents.firstR[col]), _mm_loadu_si128((const __m128i *)&parents.secondR[col]));
+        __m128i maxG = _mm_max_epu8(_mm_loadu_si128((const __m128i *)&parents.firstG[col]), _mm_loadu_si128((const __m128i *)&parents.secondG[col]));
+        __m128i maxB = _mm_max_epu8(_mm_loadu_si128((const __m128i *)&parents.firstB[col]), _mm_loadu_si128((const __m128i *)&parents.secondB[col]));
+
+        __m128i rotation = _mm_loadu_si128((const __m128i *)&parents.rotation[col]);
+        __m128i rotation1 = _mm_cmpeq_epi8(rotation, one);
+        __m128i rotation2 = _mm_cmpeq_epi8(rotation, two);
+
+        __m128i r = select_sse2(rotation1, maxB, select_sse2(rotation2, maxG, maxR));
+        __m128i g = select_sse2(rotation1, maxR, select_sse2(rotation2, maxB, maxG));
+        __m128i b = select_sse2(rotation1, maxG, select_sse2(rotation2, maxR, maxB));
+
+        _mm_storeu_si128((__m128i *)&R[col], r);
+        _mm_storeu_si128((__m128i *)&G[col], g);
+        _mm_storeu_si128((__m128i *)&B[col], b);
+
+        __m128i fitnessLow = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(r, zero), _mm_unpacklo_epi8(g, zero)), _mm_unpacklo_epi8(b, zero));
+        __m128i fitnessHigh = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(r, zero), _mm_unpackhi_epi8(g, zero)), _mm_unpackhi_epi8(b, zero));
+        _mm_storeu_si128((__m128i *)&fitness[col], fitnessLow);
+        _mm_storeu_si128((__m128i *)&fitness[col + 8], fitnessHigh);
+    }
+    reproduce_row_scalar(parents, col, to, R, G, B, fitness);
+}
+
+__attribute__((target("avx2"))) void reproduce_row_avx2(const ParentRows &parents, const uint from, const uint to, uchar *R, uchar *G, uchar *B, ushort *fitness)
+{
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i two = _mm256_set1_epi8(2);
+
+    uint col = from;
+    for (; col + 32 <= to; col += 32)
+    {
+        __m256i maxR = _mm256_max_epu8(_mm256_loadu_si256((const __m256i *)&parents.firstR[col]), _mm256_loadu_si256((const __m256i *)&parents.secondR[col]));
+        __m256i maxG = _mm256_max_epu8(_mm256_loadu_si256((const __m256i *)&parents.firstG[col]), _mm256_loadu_si256((const __m256i *)&parents.secondG[col]));
+        __m256i maxB = _mm256_max_epu8(_mm256_loadu_si256((const __m256i *)&parents.firstB[col]), _mm256_loadu_si256((const __m256i *)&parents.secondB[col]));
+
+        __m256i rotation = _mm256_loadu_si256((const __m256i *)&parents.rotation[col]);
+        __m256i rotation1 = _mm256_cmpeq_epi8(rotation, one);
+        __m256i rotation2 = _mm256_cmpeq_epi8(rotation, two);
+
+        __m256i r = _mm256_blendv_epi8(_mm256_blendv_epi8(maxR, maxG, rotation2), maxB, rotation1);
+        __m256i g = _mm256_blendv_epi8(_mm256_blendv_epi8(maxG, maxB, rotation2), maxR, rotation1);
+        __m256i b = _mm256_blendv_epi8(_mm256_blendv_epi8(maxB, maxR, rotation2), maxG, rotation1);
+
+        _mm256_storeu_si256((__m256i *)&R[col], r);
+        _mm256_storeu_si256((__m256i *)&G[col], g);
+        _mm256_storeu_si256((__m256i *)&B[col], b);
+
+        __m256i fitnessLow = _mm256_add_epi16(_mm256_add_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(r)), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(g))),
+                                              _mm256_cvtepu8_epi16(_mm256_castsi256_si128(b)));
+        __m256i fitnessHigh = _mm256_add_epi16(_mm256_add_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(r, 1)), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(g, 1))),
+                                               _mm256_cvtepu8_epi16(_mm256_extracti128_si256(b, 1)));
+        _mm256_storeu_si256((__m256i *)&fitness[col], fitnessLow);
+        _mm256_storeu_si256((__m256i *)&fitness[col + 16], fitnessHigh);
+    }
+    reproduce_row_scalar(parents, col, to, R, G, B, fitness);
+}
+
+__attribute__((target("avx512f,avx512bw"))) void reproduce_row_avx512(const ParentRows &parents, const uint from, const uint to, uchar *R, uchar *G, uchar *B, ushort *fitness)
+{
+    const __m512i one = _mm512_set1_epi8(1);
+    const __m512i two = _mm512_set1_epi8(2);
+
+    uint col = from;
+    for (; col + 64 <= to; col += 64)
+    {
+        __m512i maxR = _mm512_max_epu8(_mm512_loadu_si512(&parents.firstR[col]), _mm512_loadu_si512(&parents.secondR[col]));
+        __m512i maxG = _mm512_max_epu8(_mm512_loadu_si512(&parents.firstG[col]), _mm512_loadu_si512(&parents.secondG[col]));
+        __m512i maxB = _mm512_max_epu8(_mm512_loadu_si512(&parents.firstB[col]), _mm512_loadu_si512(&parents.secondB[col]));
+
+        __m512i rotation = _mm512_loadu_si512(&parents.rotation[col]);
+        __mmask64 rotation1 = _mm512_cmpeq_epi8_mask(rotation, one);
+        __mmask64 rotation2 = _mm512_cmpeq_epi8_mask(rotation, two);
+
+        __m512i r = _mm512_mask_blend_epi8(rotation1, _mm512_mask_blend_epi8(rotation2, maxR, maxG), maxB);
+        __m512i g = _mm512_mask_blend_epi8(rotation1, _mm512_mask_blend_epi8(rotation2, maxG, maxB), maxR);
+        __m512i b = _mm512_mask_blend_epi8(rotation1, _mm512_mask_blend_epi8(rotation2, maxB, maxR), maxG);
+
+        _mm512_storeu_si512(&R[col], r);
+        _mm512_storeu_si512(&G[col], g);
+        _mm512_storeu_si512(&B[col], b);
+
+        __m512i fitnessLow = _mm512_add_epi16(_mm512_add_epi16(_mm512_cvtepu8_epi16(_mm512_castsi512_si256(r)), _mm512_cvtepu8_epi16(_mm512_castsi512_si256(g))),
+                                              _mm512_cvtepu8_epi16(_mm512_castsi512_si256(b)));
+        __m512i fitnessHigh = _mm512_add_epi16(_mm512_add_epi16(_mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(r, 1)), _mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(g, 1))),
+                                               _mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(b, 1)));
+        _mm512_storeu_si512(&fitness[col], fitnessLow);
+        _mm512_storeu_si512(&fitness[col + 32], fitnessHigh);
+    }
+    reproduce_row_scalar(parents, col, to, R, G, B, fitness);
+}
+
+#endif
+
+// Picks the widest instruction set supported by the running CPU.
+ReproduceRowFunction select_reproduce_row()
+{
+#ifdef CGA_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw"))
+        return reproduce_row_avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return reproduce_row_avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return reproduce_row_sse2;
+#endif
+    return reproduce_row_scalar;
+}
+
+// Writes offspring of columns [from, to) of one row, R, G, B and fitness point to the start of the row.
+inline void reproduce_row(const ParentRows &parents, const uint from, const uint to, uchar *R, uchar *G, uchar *B, ushort *fitness)
+{
+    static const ReproduceRowFunction reproduceRow = select_reproduce_row();
+    reproduceRow(parents, from, to, R, G, B, fitness);
+}
\ No newline at end of file
@@ -0,0 +1,161 @@
+#pragma once
+#include "cell.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <deque>
+#include <vector>
+
+// Number of snapshot buffers, evolution waits for the writer only when all of them are queued.
+constexpr size_t SNAPSHOT_QUEUE_CAPACITY = 4;
+
+// Image of one generation copied out of the population.
+// Channels are stored as separate planes of width * height bytes in row-major order.
+struct Snapshot
+{
+    uint generation;
+    uint width;
+    uint height;
+    uint channelCount;
+    std::vector<uchar> pixels;
+
+    Snapshot()
+    {
+        generation = 0;
+        width = 0;
+        height = 0;
+        channelCount = 0;
+    }
+
+    void resize(const uint width, const uint height, const uint channelCount)
+    {
+        this->width = width;
+        this->height = height;
+        this->channelCount = channelCount;
+        pixels.resize((size_t)width * height * channelCount);
+    }
+
+    uchar *channel(const uint channel)
+    {
+        return pixels.data() + ((size_t)channel * width * height);
+    }
+};
+
+// Encodes and writes snapshots on a dedicated I/O thread, so that disk writes overlap with evolution.
+// Buffers are recycled: acquire() hands out a free one and blocks only while all of them wait in the queue,
+// submit() queues the filled buffer. Destructor writes the queued snapshots before it returns.
+// First failed write stops further writes and is rethrown to the evolving thread by the next acquire() or by finish().
+class SnapshotWriter
+{
+public:
+    typedef std::function<void(const Snapshot &snapshot)> Write;
+
+    SnapshotWriter(const Write &write, const size_t capacity = SNAPSHOT_QUEUE_CAPACITY) : write(write), buffers(capacity)
+    {
+        stopping = false;
+        for (Snapshot &buffer : buffers)
+            freeBuffers.push_back(&buffer);
+        thread = std::thread(&SnapshotWriter::writer_loop, this);
+    }
+
+    ~SnapshotWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        snapshotQueued.notify_one();
+        thread.join();
+    }
+
+    SnapshotWriter(const SnapshotWriter &) = delete;
+    SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+    Snapshot &acquire()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        bufferFreed.wait(lock, [this] { return error || !freeBuffers.empty(); });
+        if (error)
+            std::rethrow_exception(error);
+        Snapshot *buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+        return *buffer;
+    }
+
+    void submit(Snapshot &snapshot)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queuedBuffers.push_back(&snapshot);
+        }
+        snapshotQueued.notify_one();
+    }
+
+    // Waits until all queued snapshots are written and rethrows the failed write, if any.
+    void finish()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        bufferFreed.wait(lock, [this] { return freeBuffers.size() == buffers.size(); });
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+private:
+    Write write;
+    std::vector<Snapshot> buffers;
+    std::vector<Snapshot *> freeBuffers;
+    std::deque<Snapshot *> queuedBuffers;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable snapshotQueued;
+    std::condition_variable bufferFreed;
+    bool stopping;
+    std::exception_ptr error;
+
+    void writer_loop()
+    {
+        while (true)
+        {
+            Snapshot *snapshot;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                snapshotQueued.wait(lock, [this] { return stopping || !queuedBuffers.empty(); });
+                if (queuedBuffers.empty())
+                    return;
+                snapshot = queuedBuffers.front();
+                queuedBuffers.pop_front();
+            }
+
+            // Exception can't leave the I/O thread, it is kept for the evolving thread instead.
+            // Snapshots after a failed write are dropped, a frame stream couldn't decode them anyway.
+            std::exception_ptr writeError;
+            bool failed;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                failed = (bool)error;
+            }
+            if (!failed)
+            {
+                try
+                {
+                    write(*snapshot);
+                }
+                catch (...)
+                {
+                    writeError = std::current_exception();
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (writeError)
+                    error = writeError;
+                freeBuffers.push_back(snapshot);
+            }
+            bufferFreed.notify_all();
+        }
+    }
+};
\ No newline at end of file
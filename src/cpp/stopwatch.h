@@ -1,23 +1,37 @@
+#pragma once
 #include <chrono>
+#include <stdint.h>
+
+// Steady clock never jumps, so intervals are right even when the system time is adjusted during a run.
+typedef std::chrono::steady_clock StopwatchClock;
 
 struct StopwatchData
 {
-    std::chrono::high_resolution_clock::time_point start;
-    std::chrono::high_resolution_clock::time_point end;
+    StopwatchClock::time_point start;
+    StopwatchClock::time_point end;
 };
 
-void start_stopwatch(StopwatchData &stopwatchData)
+inline uint64_t now_nanoseconds()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(StopwatchClock::now().time_since_epoch()).count();
+}
+
+inline void start_stopwatch(StopwatchData &stopwatchData)
 {
-    stopwatchData.start = std::chrono::high_resolution_clock::now();
+    stopwatchData.start = StopwatchClock::now();
 }
-void stop_stopwatch(StopwatchData &stopwatchData)
+inline void stop_stopwatch(StopwatchData &stopwatchData)
+{
+    stopwatchData.end = StopwatchClock::now();
+}
+
+inline uint64_t elapsed_nanoseconds(const StopwatchData &stopwatchData)
 {
-    stopwatchData.end = std::chrono::high_resolution_clock::now();
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(stopwatchData.end - stopwatchData.start).count();
 }
 
-double elapsed_milliseconds(StopwatchData &stopwatchData)
+// Fractional milliseconds, intervals shorter than a millisecond don't round down to zero.
+inline double elapsed_milliseconds(const StopwatchData &stopwatchData)
 {
-    auto duration = stopwatchData.end - stopwatchData.start;
-    double milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
-    return milliseconds;
+    return elapsed_nanoseconds(stopwatchData) / 1e6;
 }
\ No newline at end of file
@@ -0,0 +1,156 @@
+#pragma once
+#include "cell.h"
+#include <deque>
+#include <mutex>
+#include <vector>
+
+constexpr uint DEFAULT_TILE_SIZE = 64;
+
+// Rectangular part of the grid, rows [rowFrom, rowTo) and columns [colFrom, colTo).
+struct Tile
+{
+    uint index;
+    uint rowFrom;
+    uint rowTo;
+    uint colFrom;
+    uint colTo;
+};
+
+// Convergence bookkeeping of tiles.
+// Tile whose cells and surrounding tiles are all at maximal fitness produces only maximal offspring,
+// these can't replace anything with a worse genome, so the tile doesn't have to be evolved.
+struct TileActivity
+{
+    uint tileRowCount;
+    uint tileColCount;
+    // Every cell of the tile has maximal fitness.
+    std::vector<uchar> optimal;
+    // Tile was evolved in the last generation and optimal has to be checked again.
+    std::vector<uchar> stale;
+    // Tile was skipped in the last generation, so its offspring are still in place.
+    std::vector<uchar> skipped;
+
+    TileActivity()
+    {
+        tileRowCount = 0;
+        tileColCount = 0;
+    }
+
+    void reset(const uint tileRowCount, const uint tileColCount)
+    {
+        this->tileRowCount = tileRowCount;
+        this->tileColCount = tileColCount;
+        optimal.assign(tileRowCount * tileColCount, 0);
+        stale.assign(tileRowCount * tileColCount, 1);
+        skipped.assign(tileRowCount * tileColCount, 0);
+    }
+
+    bool matches(const uint tileRowCount, const uint tileColCount) const
+    {
+        return (this->tileRowCount == tileRowCount) && (this->tileColCount == tileColCount);
+    }
+
+    // Tile with the eight surrounding tiles of the toroidal grid.
+    bool can_skip(const uint tile) const
+    {
+        uint tileRow = tile / tileColCount;
+        uint tileCol = tile % tileColCount;
+        for (uint dRow = tileRowCount - 1; dRow <= tileRowCount + 1; dRow++)
+        {
+            for (uint dCol = tileColCount - 1; dCol <= tileColCount + 1; dCol++)
+            {
+                if (!optimal[(((tileRow + dRow) % tileRowCount) * tileColCount) + ((tileCol + dCol) % tileColCount)])
+                    return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Work-stealing distribution of tiles among workers.
+// Every worker starts with a contiguous run of tiles in its own queue and takes them from the front,
+// a worker with an empty queue steals from the back of the others, so fast workers keep busy until the grid is done.
+class TileScheduler
+{
+public:
+    void reset(const uint rowCount, const uint colCount, const uint tileRows, const uint tileCols, const int workerCount)
+    {
+        this->rowCount = rowCount;
+        this->colCount = colCount;
+        this->tileRows = tileRows;
+        this->tileCols = tileCols;
+        tileColCount = (colCount + tileCols - 1) / tileCols;
+        uint tileCount = ((rowCount + tileRows - 1) / tileRows) * tileColCount;
+
+        if ((int)queues.size() != workerCount)
+            queues = std::vector<TileQueue>(workerCount);
+
+        for (int workerId = 0; workerId < workerCount; workerId++)
+        {
+            uint from = (tileCount * workerId) / workerCount;
+            uint to = (tileCount * (workerId + 1)) / workerCount;
+
+            TileQueue &queue = queues[workerId];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tiles.clear();
+            for (uint tile = from; tile < to; tile++)
+                queue.tiles.push_back(tile);
+        }
+    }
+
+    // Returns false when no tile is left in any queue.
+    bool next(const int workerId, Tile &tile)
+    {
+        uint tileIndex;
+        if (!pop_front(queues[workerId], tileIndex))
+        {
+            bool stolen = false;
+            int workerCount = (int)queues.size();
+            for (int k = 1; (k < workerCount) && !stolen; k++)
+                stolen = pop_back(queues[(workerId + k) % workerCount], tileIndex);
+            if (!stolen)
+                return false;
+        }
+
+        tile.index = tileIndex;
+        tile.rowFrom = (tileIndex / tileColCount) * tileRows;
+        tile.colFrom = (tileIndex % tileColCount) * tileCols;
+        tile.rowTo = std::min(tile.rowFrom + tileRows, rowCount);
+        tile.colTo = std::min(tile.colFrom + tileCols, colCount);
+        return true;
+    }
+
+private:
+    struct TileQueue
+    {
+        std::mutex mutex;
+        std::deque<uint> tiles;
+    };
+
+    std::vector<TileQueue> queues;
+    uint rowCount;
+    uint colCount;
+    uint tileRows;
+    uint tileCols;
+    uint tileColCount;
+
+    static bool pop_front(TileQueue &queue, uint &tileIndex)
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tiles.empty())
+            return false;
+        tileIndex = queue.tiles.front();
+        queue.tiles.pop_front();
+        return true;
+    }
+
+    static bool pop_back(TileQueue &queue, uint &tileIndex)
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tiles.empty())
+            return false;
+        tileIndex = queue.tiles.back();
+        queue.tiles.pop_back();
+        return true;
+    }
+};
\ No newline at end of file
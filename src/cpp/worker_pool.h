@@ -0,0 +1,100 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <stdint.h>
+
+// Threads created once and woken for every job, so a generation does not pay for thread creation.
+// Calling thread takes part as worker 0, run() returns after all workers have finished the job.
+class WorkerPool
+{
+public:
+    typedef std::function<void(const int workerId, const int workerCount)> Job;
+
+    WorkerPool(const int workerCount)
+    {
+        job = nullptr;
+        jobNumber = 0;
+        runningCount = 0;
+        stopping = false;
+
+        // Calling thread always works, so there is at least one worker.
+        if (workerCount > 1)
+            threads.reserve(workerCount - 1);
+        for (int workerId = 1; workerId < workerCount; workerId++)
+            threads.emplace_back(&WorkerPool::worker_loop, this, workerId);
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobReady.notify_all();
+
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    int size() const
+    {
+        return (int)threads.size() + 1;
+    }
+
+    void run(const Job &job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            this->job = &job;
+            runningCount = (int)threads.size();
+            jobNumber++;
+        }
+        jobReady.notify_all();
+
+        job(0, size());
+
+        std::unique_lock<std::mutex> lock(mutex);
+        jobDone.wait(lock, [this] { return runningCount == 0; });
+        this->job = nullptr;
+    }
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+
+    const Job *job;
+    uint64_t jobNumber;
+    int runningCount;
+    bool stopping;
+
+    void worker_loop(const int workerId)
+    {
+        uint64_t finishedJobNumber = 0;
+        while (true)
+        {
+            const Job *currentJob;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobReady.wait(lock, [&] { return stopping || (jobNumber != finishedJobNumber); });
+                if (stopping)
+                    return;
+                currentJob = job;
+                finishedJobNumber = jobNumber;
+            }
+
+            (*currentJob)(workerId, size());
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--runningCount == 0)
+                jobDone.notify_one();
+        }
+    }
+};
\ No newline at end of file